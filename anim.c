@@ -0,0 +1,114 @@
+// Copyright 2023 David Lareau. This program is free software under the terms of the Zero Clause BSD.
+#include <stdio.h>
+#include <string.h>
+#include <libxml/xmlmemory.h>
+#include <libxml/parser.h>
+#include "anim.h"
+#include "mem.h"
+#include "pack.h"
+
+static uint64_t gcd(uint64_t a, uint64_t b) {
+  while(b) { uint64_t t = a % b; a = b; b = t; }
+  return a;
+}
+
+static int image_index(struct anim_set * self, const char * filename) {
+  for(int i = 0; i < self->image_count; i++) if(strcmp(self->images[i], filename) == 0) return i;
+  self->images = mem_realloc(MEM_ANIM, self->images, self->image_count + 1, sizeof(char *));
+  if(!self->images) { printf("out of mem\n"); exit(EXIT_FAILURE); }
+  self->images[self->image_count] = mem_strdup(MEM_ANIM, filename);
+  return self->image_count++;
+}
+
+static double number_prop(xmlNode * node, const char * name, double fallback) {
+  xmlChar * value = xmlGetProp(node, name);
+  double n = value? strtod(value, NULL) : fallback;
+  xmlFree(value);
+  return n;
+}
+
+static bool bool_prop(xmlNode * node, const char * name) {
+  xmlChar * value = xmlGetProp(node, name);
+  bool b = value && xmlStrcmp(value, "true") == 0;
+  xmlFree(value);
+  return b;
+}
+
+void anim_load(struct anim_set * self, const char * filename) {
+  memset(self, 0, sizeof(struct anim_set));
+  xmlDoc * doc = pack_xml(filename); if(!doc) { printf("pack_xml(%s) failed.\n", filename); exit(EXIT_FAILURE); }
+  xmlNode * root = xmlDocGetRootElement(doc); if(!root) { printf("xmlDocGetRootElement() is null.\n"); exit(EXIT_FAILURE); }
+  // count clips and frames
+  for(xmlNode * ccur = root->xmlChildrenNode; ccur; ccur = ccur->next) {
+    if(xmlStrcmp(ccur->name, "clip") != 0) continue;
+    self->clip_count++;
+    for(xmlNode * fcur = ccur->xmlChildrenNode; fcur; fcur = fcur->next) if(xmlStrcmp(fcur->name, "frame") == 0) self->frame_count++;
+  }
+  self->clips = mem_calloc(MEM_ANIM, self->clip_count, sizeof(struct anim_clip));
+  self->frames = mem_calloc(MEM_ANIM, self->frame_count, sizeof(struct anim_frame));
+  uint64_t * durations = mem_alloc(MEM_ANIM, sizeof(uint64_t) * self->frame_count);
+  if(!self->clips || !self->frames || !durations) { printf("out of mem\n"); exit(EXIT_FAILURE); }
+  // populate
+  int c = 0, f = 0;
+  for(xmlNode * ccur = root->xmlChildrenNode; ccur; ccur = ccur->next) {
+    if(xmlStrcmp(ccur->name, "clip") != 0) continue;
+    struct anim_clip * clip = &self->clips[c++];
+    xmlChar * name = xmlGetProp(ccur, "name"); if(!name) { printf("%s: clip without a name.\n", filename); exit(EXIT_FAILURE); }
+    clip->name = mem_strdup(MEM_ANIM, name);
+    xmlFree(name);
+    int first = f;
+    uint64_t total = 0;
+    for(xmlNode * fcur = ccur->xmlChildrenNode; fcur; fcur = fcur->next) {
+      if(xmlStrcmp(fcur->name, "frame") != 0) continue;
+      struct anim_frame * frame = &self->frames[f];
+      xmlChar * image = xmlGetProp(fcur, "image"); if(!image) { printf("%s: %s frame without an image.\n", filename, clip->name); exit(EXIT_FAILURE); }
+      frame->image = image_index(self, image);
+      xmlFree(image);
+      frame->source = (struct rect){number_prop(fcur, "x", 0), number_prop(fcur, "y", 0), number_prop(fcur, "width", 0), number_prop(fcur, "height", 0)};
+      frame->mirror = bool_prop(fcur, "mirror");
+      durations[f] = number_prop(fcur, "duration", 1000);
+      if(durations[f] == 0) { printf("%s: %s has a 0 duration frame.\n", filename, clip->name); exit(EXIT_FAILURE); }
+      clip->quantum = gcd(clip->quantum, durations[f]);
+      total += durations[f];
+      f++;
+    }
+    if(f == first) { printf("%s: %s has no frames.\n", filename, clip->name); exit(EXIT_FAILURE); }
+    // one entry per quantum, so durations that don't divide evenly still land on exact frame boundaries
+    uint64_t size = total / clip->quantum;
+    clip->table = mem_alloc(MEM_ANIM, sizeof(int) * size);
+    if(!clip->table) { printf("out of mem\n"); exit(EXIT_FAILURE); }
+    uint64_t i = 0;
+    for(int j = first; j < f; j++) {
+      for(uint64_t k = 0; k < durations[j] / clip->quantum; k++) clip->table[i++] = j;
+    }
+    clip->last = size - 1;
+    clip->wrap = bool_prop(ccur, "loop")? total : UINT64_MAX;
+  }
+  mem_free(durations);
+  xmlFreeDoc(doc);
+}
+
+void anim_free(struct anim_set * self) {
+  for(int i = 0; i < self->image_count; i++) mem_free(self->images[i]);
+  mem_free(self->images);
+  for(int i = 0; i < self->clip_count; i++) {
+    mem_free(self->clips[i].name);
+    mem_free(self->clips[i].table);
+  }
+  mem_free(self->clips);
+  mem_free(self->frames);
+}
+
+int anim_find(const struct anim_set * self, const char * name) {
+  for(int i = 0; i < self->clip_count; i++) if(strcmp(self->clips[i].name, name) == 0) return i;
+  return -1;
+}
+
+void anim_set_image_size(struct anim_set * self, int image, int w, int h) {
+  for(int i = 0; i < self->frame_count; i++) {
+    struct anim_frame * frame = &self->frames[i];
+    if(frame->image != image || frame->source.w || frame->source.h) continue;
+    frame->source.w = w;
+    frame->source.h = h;
+  }
+}
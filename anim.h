@@ -0,0 +1,46 @@
+#pragma once
+// Copyright 2023 David Lareau. This program is free software under the terms of the Zero Clause BSD.
+#include <stdint.h>
+#include <stdbool.h>
+#include "collision.h"
+
+// sprite animation clips, defined in data (see clips.xml) and looked up by handle
+// - a clip is a list of frames (image, source rect, mirror) with durations in milliseconds, looping or played once
+// - at load each clip gets a table of frame indices, one entry per gcd of its durations, so finding the frame is a division and a lookup
+// - a one-shot clip stays on its last frame once it's over
+
+struct anim_frame {
+  int image; // index in anim_set.images
+  struct rect source; // 0 width/height until anim_set_image_size() fills it with the whole image
+  bool mirror;
+};
+
+struct anim_clip {
+  char * name;
+  uint64_t quantum; // gcd of the frame durations
+  uint64_t wrap; // total duration when looping, UINT64_MAX when played once
+  uint64_t last; // index of the last table entry
+  int * table; // frame index per quantum
+};
+
+struct anim_set {
+  int image_count;
+  char ** images; // filenames, each listed once
+  int frame_count;
+  struct anim_frame * frames;
+  int clip_count;
+  struct anim_clip * clips;
+};
+
+void anim_load(struct anim_set * self, const char * filename);
+void anim_free(struct anim_set * self);
+int anim_find(const struct anim_set * self, const char * name); // clip handle, or -1
+void anim_set_image_size(struct anim_set * self, int image, int w, int h); // for frames that use the whole image
+
+// the frame showing elapsed milliseconds after the clip started
+static inline const struct anim_frame * anim_frame(const struct anim_set * self, int clip, uint64_t elapsed) {
+  const struct anim_clip * c = &self->clips[clip];
+  uint64_t i = (elapsed % c->wrap) / c->quantum;
+  i = (i < c->last)? i : c->last;
+  return &self->frames[c->table[i]];
+}
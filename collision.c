@@ -0,0 +1,165 @@
+// Copyright 2023 David Lareau. This program is free software under the terms of the Zero Clause BSD.
+#include <math.h>
+#include "collision.h"
+
+bool collides_1D(double p, double pl, double q, double ql) {
+  return p + pl >= q && p <= q + ql;
+}
+
+bool collides_2D(const struct rect * p, const struct rect * q) {
+  return collides_1D(p->x, p->w, q->x, q->w) && collides_1D(p->y, p->h, q->y, q->h);
+}
+
+bool collides_2D_dx(double px, double py, double pw, double ph, const struct rect * q) {
+  struct rect p = {px, py, pw, ph};
+  return collides_2D(&p, q);
+}
+
+// crossings happening within this time of each other are considered simultaneous
+static const double EPSILON = 1e-9;
+
+static bool solid_at(const struct sweep_world * w, int col, int row) {
+  if(col < 0 && !w->exits[WEST]) return true;
+  if(col >= w->cols && !w->exits[EAST]) return true;
+  if(row < 0 && !w->exits[NORTH]) return true;
+  if(row >= w->rows && !w->exits[SOUTH]) return true;
+  if(col < 0 || col >= w->cols || row < 0 || row >= w->rows) return false;
+  return w->solid[row * w->cols + col];
+}
+
+// cells covered by [p, p + pl[
+static void span(double p, double pl, double ts, int * first, int * last) {
+  *first = (int)floor(p / ts);
+  *last = (int)ceil((p + pl) / ts) - 1;
+}
+
+// grid DDA of the leading edges, only the cells newly entered at each line crossing are tested
+static bool sweep_tiles(const struct sweep_world * w, const struct rect * box, double dx, double dy, double limit, struct sweep * hit) {
+  const double ts = w->tile_size;
+  // time of the next vertical line crossing, and the column it enters
+  double tx = INFINITY, tx_step = INFINITY; int col = 0, step_x = dx > 0? 1 : -1;
+  if(dx > 0) { double line = ceil((box->x + box->w) / ts); col = (int)line; tx = (line * ts - box->x - box->w) / dx; tx_step = ts / dx; }
+  else if(dx < 0) { double line = floor(box->x / ts); col = (int)line - 1; tx = (line * ts - box->x) / dx; tx_step = -ts / dx; }
+  // time of the next horizontal line crossing, and the row it enters
+  double ty = INFINITY, ty_step = INFINITY; int row = 0, step_y = dy > 0? 1 : -1;
+  if(dy > 0) { double line = ceil((box->y + box->h) / ts); row = (int)line; ty = (line * ts - box->y - box->h) / dy; ty_step = ts / dy; }
+  else if(dy < 0) { double line = floor(box->y / ts); row = (int)line - 1; ty = (line * ts - box->y) / dy; ty_step = -ts / dy; }
+  while(true) {
+    if(tx <= ty) {
+      if(tx > limit) return false;
+      int first, last; span(box->y + dy * tx, box->h, ts, &first, &last);
+      // a row entered at the same instant is part of this crossing, otherwise diagonal moves slip between corners
+      if(ty - tx <= EPSILON) { if(dy > 0) last = row; else first = row; }
+      for(int r = first; r <= last; r++) {
+        if(solid_at(w, col, r)) {
+          hit->t = tx;
+          hit->x = (dx > 0)? col * ts - box->w : (col + 1) * ts;
+          hit->y = box->y + dy * tx;
+          hit->nx = -step_x;
+          hit->ny = 0;
+          hit->body = -1;
+          return true;
+        }
+      }
+      tx += tx_step;
+      col += step_x;
+    } else {
+      if(ty > limit) return false;
+      int first, last; span(box->x + dx * ty, box->w, ts, &first, &last);
+      if(tx - ty <= EPSILON) { if(dx > 0) last = col; else first = col; }
+      for(int c = first; c <= last; c++) {
+        if(solid_at(w, c, row)) {
+          hit->t = ty;
+          hit->x = box->x + dx * ty;
+          hit->y = (dy > 0)? row * ts - box->h : (row + 1) * ts;
+          hit->nx = 0;
+          hit->ny = -step_y;
+          hit->body = -1;
+          return true;
+        }
+      }
+      ty += ty_step;
+      row += step_y;
+    }
+  }
+}
+
+// time interval during which [p + d * t, p + pl + d * t] overlaps [q, q + ql]
+static void axis_times(double p, double pl, double d, double q, double ql, double * entry, double * exit) {
+  if(d > 0) { *entry = (q - p - pl) / d; *exit = (q + ql - p) / d; }
+  else if(d < 0) { *entry = (q + ql - p) / d; *exit = (q - p - pl) / d; }
+  else if(p < q + ql && p + pl > q) { *entry = -INFINITY; *exit = INFINITY; }
+  else { *entry = INFINITY; *exit = -INFINITY; }
+}
+
+static bool sweep_body(const struct rect * box, double dx, double dy, const struct body * b, struct sweep * hit) {
+  const struct rect * q = &b->r;
+  double entry_x, exit_x, entry_y, exit_y;
+  axis_times(box->x, box->w, dx, q->x, q->w, &entry_x, &exit_x);
+  axis_times(box->y, box->h, dy, q->y, q->h, &entry_y, &exit_y);
+  double entry = fmax(entry_x, entry_y);
+  double exit = fmin(exit_x, exit_y);
+  if(entry >= exit || entry > 1 || exit <= 0) return false;
+  if(entry < 0) {
+    // already overlapping
+    if(b->flags & BODY_SOLID) return false;
+    entry = 0;
+  }
+  hit->t = entry;
+  hit->x = box->x + dx * entry;
+  hit->y = box->y + dy * entry;
+  hit->nx = hit->ny = 0;
+  if(entry_x > entry_y) {
+    hit->nx = (dx > 0)? -1 : 1;
+    if(b->flags & BODY_SOLID) hit->x = (dx > 0)? q->x - box->w : q->x + q->w;
+  } else {
+    hit->ny = (dy > 0)? -1 : 1;
+    if(b->flags & BODY_SOLID) hit->y = (dy > 0)? q->y - box->h : q->y + q->h;
+  }
+  return true;
+}
+
+bool sweep_box(const struct sweep_world * world, const struct rect * box, double dx, double dy, int mask, struct sweep * hit) {
+  struct sweep best = {INFINITY};
+  for(int i = 0; i < world->body_count; i++) {
+    struct sweep candidate;
+    if(!(world->bodies[i].flags & mask)) continue;
+    if(sweep_body(box, dx, dy, &world->bodies[i], &candidate) && candidate.t < best.t) {
+      best = candidate;
+      best.body = i;
+    }
+  }
+  if(mask & BODY_SOLID) {
+    struct sweep candidate;
+    if(sweep_tiles(world, box, dx, dy, fmin(best.t, 1), &candidate)) best = candidate;
+  }
+  if(best.t > 1) return false;
+  *hit = best;
+  return true;
+}
+
+bool slide_box(const struct sweep_world * world, struct rect * box, double dx, double dy, struct sweep * trigger) {
+  // each contact removes one axis of motion, so two contacts is as many as can matter
+  // the first leg runs even without motion, so standing in a trigger still reports it
+  for(int i = 0; i < 3; i++) {
+    struct sweep hit;
+    bool blocked = sweep_box(world, box, dx, dy, BODY_SOLID, &hit);
+    // a trigger behind the solid contact isn't reached on this leg
+    if(trigger && sweep_box(world, box, dx, dy, BODY_TRIGGER, trigger) && (!blocked || trigger->t <= hit.t)) {
+      box->x = trigger->x;
+      box->y = trigger->y;
+      return true;
+    }
+    if(!blocked) {
+      box->x += dx;
+      box->y += dy;
+      return false;
+    }
+    box->x = hit.x;
+    box->y = hit.y;
+    dx = hit.nx? 0 : dx * (1 - hit.t);
+    dy = hit.ny? 0 : dy * (1 - hit.t);
+    if(dx == 0 && dy == 0) return false;
+  }
+  return false;
+}
@@ -0,0 +1,49 @@
+#pragma once
+// Copyright 2023 David Lareau. This program is free software under the terms of the Zero Clause BSD.
+#include <stdbool.h>
+
+// axis-aligned boxes, and a swept box query against a tile grid and a handful of bodies
+
+struct rect {
+  double x;
+  double y;
+  double w;
+  double h;
+};
+
+bool collides_1D(double p, double pl, double q, double ql);
+bool collides_2D(const struct rect * p, const struct rect * q);
+bool collides_2D_dx(double px, double py, double pw, double ph, const struct rect * q);
+
+enum body_flag { BODY_SOLID = 1, BODY_TRIGGER = 2 };
+enum edge { NORTH, SOUTH, EAST, WEST };
+
+struct body {
+  struct rect r;
+  int flags;
+};
+
+struct sweep_world {
+  const bool * solid; // cols * rows, row major
+  int cols;
+  int rows;
+  double tile_size;
+  bool exits[4]; // indexed by enum edge, when set the cells past that edge are open instead of solid
+  const struct body * bodies;
+  int body_count;
+};
+
+struct sweep {
+  double t; // time of impact in [0, 1] along (dx, dy)
+  double x, y; // box position at impact, snapped exactly against the contact
+  int nx, ny; // contact normal
+  int body; // index in bodies, or -1 for a tile
+};
+
+// moves box by (dx, dy) and returns the first thing it touches whose flags intersects mask (tiles count as BODY_SOLID)
+// cost is proportional to the number of tile lines crossed plus the number of bodies, regardless of speed
+// solids the box already overlaps at t=0 are ignored so it can walk out of them, triggers report t=0
+bool sweep_box(const struct sweep_world * world, const struct rect * box, double dx, double dy, int mask, struct sweep * hit);
+// moves box by (dx, dy), stopping against solids and sliding along them with the remaining motion
+// unless trigger is NULL, each leg of the slide also looks for triggers: the first one touched no later than the leg's solid contact stops the box there and returns true
+bool slide_box(const struct sweep_world * world, struct rect * box, double dx, double dy, struct sweep * trigger);
@@ -1,8 +1,8 @@
 // Copyright 2020 David Lareau. This source code form is subject to the terms of the Mozilla Public License 2.0.
-#define _GNU_SOURCE // for reallocarray on raspberry pi OS which has old libc
 #include <stdio.h>
 #include <string.h>
 #include "data-util.h"
+#include "mem.h"
 
 static size_t _find(struct dict * self, intptr_t key) {
   // TODO binary search on large array, even smaller threshold if strcmp
@@ -19,19 +19,19 @@ void dict_init(struct dict * self, size_t memcpy_size, bool key_str, bool dup_st
   self->dup_str = dup_str;
   self->capacity = 4;
   self->size = 0;
-  self->keys = reallocarray(NULL, self->capacity, sizeof(intptr_t));
-  self->vals = reallocarray(NULL, self->capacity, self->memcpy_size? self->memcpy_size : sizeof(intptr_t));
+  self->keys = mem_realloc(MEM_DICT, NULL, self->capacity, sizeof(intptr_t));
+  self->vals = mem_realloc(MEM_DICT, NULL, self->capacity, self->memcpy_size? self->memcpy_size : sizeof(intptr_t));
   self->has_cache = -1;
 }
 
 void dict_free(struct dict * self) {
   if(self->dup_str) {
     for(int i = 0; i < self->size; i++) {
-      free(self->keys[i]);
+      mem_free(self->keys[i]);
     }
   }
-  free(self->keys);
-  free(self->vals);
+  mem_free(self->keys);
+  mem_free(self->vals);
 }
 
 void dict_set(struct dict * self, intptr_t key, intptr_t val) {
@@ -41,12 +41,12 @@ void dict_set(struct dict * self, intptr_t key, intptr_t val) {
     // grow
     if(self->size == self->capacity) {
       self->capacity *= 2;
-      self->keys = reallocarray(self->keys, self->capacity, sizeof(intptr_t));
-      self->vals = reallocarray(self->vals, self->capacity, self->memcpy_size? self->memcpy_size : sizeof(intptr_t));
+      self->keys = mem_realloc(MEM_DICT, self->keys, self->capacity, sizeof(intptr_t));
+      self->vals = mem_realloc(MEM_DICT, self->vals, self->capacity, self->memcpy_size? self->memcpy_size : sizeof(intptr_t));
       if(!self->keys || !self->vals) { printf("out of mem\n"); exit(EXIT_FAILURE); };
     }
     // dup key
-    if(self->dup_str) key = strdup(key);
+    if(self->dup_str) key = mem_strdup(MEM_DICT, key);
     // shift keys and insert it
     self->size++;
     int above = self->size - i - 1;
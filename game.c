@@ -0,0 +1,262 @@
+// Copyright 2023 David Lareau. This program is free software under the terms of the Zero Clause BSD.
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "game.h"
+
+const char * MESSAGES[MESSAGE_COUNT] = {
+  NULL,
+  "I'm hungry. I want candy.",
+  "A candy cane! Thank you so much. You may pass.",
+  "I'm so hungry. I really want candy!",
+  "You open the chest with the key, and find an empty bottle.",
+  "The chest is locked.",
+  "The chest is empty.",
+  "You douse the flame with your water bottle, and find a magic staff.",
+  "You found my staff. Thank you. Let me teach you the magic spell 'Kaboom'.",
+  "Thank you for returning my staff.",
+  "I cannot find my magic staff. Will you help?",
+  "This is princess Purple Dress's garden, and don't go pass it or eat the carrots please.",
+};
+
+const char * SOUND_FILES[SOUND_COUNT] = {NULL, "elf_0.ogg", "elf_1.ogg", "elf_2.ogg", "open.ogg", "locked.ogg", "empty.ogg", "flame.ogg", "wiz_0.ogg", "wiz_1.ogg", "wiz_2.ogg", "garden.ogg"};
+
+const struct rect PRINCESS_COLLISION = {1, 14, 12, 8}; // hard-coded princess collision box
+static const double STEP_PER_SECONDS = 125;
+
+void game_init(struct game_state * self) {
+  memset(self, 0, sizeof(struct game_state)); // padding too, so identical states give identical snapshots
+  self->map = -1;
+  self->next_map = 0;
+  self->forward.w = TS;
+  self->forward.h = TS;
+  self->winner_t0 = -1;
+}
+
+// bump when struct game_state changes
+static const uint32_t SNAPSHOT_VERSION = 2;
+
+struct snapshot_header {
+  char magic[4];
+  uint32_t version;
+  uint32_t size;
+};
+
+size_t game_snapshot_size(void) {
+  return sizeof(struct snapshot_header) + sizeof(struct game_state);
+}
+
+void game_snapshot(const struct game_state * self, void * blob) {
+  struct snapshot_header header = {{'Z', 'S', 'A', 'V'}, SNAPSHOT_VERSION, sizeof(struct game_state)};
+  memcpy(blob, &header, sizeof(header));
+  memcpy((uint8_t *)blob + sizeof(header), self, sizeof(struct game_state));
+}
+
+bool game_restore(struct game_state * self, const void * blob, size_t size) {
+  struct snapshot_header header;
+  if(size != game_snapshot_size()) return false;
+  memcpy(&header, blob, sizeof(header));
+  if(memcmp(header.magic, "ZSAV", 4) != 0 || header.version != SNAPSHOT_VERSION || header.size != sizeof(struct game_state)) return false;
+  memcpy(self, (const uint8_t *)blob + sizeof(header), sizeof(struct game_state));
+  return true;
+}
+
+bool game_save(const struct game_state * self, const char * filename) {
+  uint8_t blob[game_snapshot_size()];
+  game_snapshot(self, blob);
+  FILE * f = fopen(filename, "wb"); if(!f) return false;
+  bool ok = fwrite(blob, sizeof(blob), 1, f) == 1;
+  return fclose(f) == 0 && ok;
+}
+
+bool game_load(struct game_state * self, const char * filename) {
+  uint8_t blob[game_snapshot_size() + 1];
+  FILE * f = fopen(filename, "rb"); if(!f) return false;
+  size_t size = fread(blob, 1, sizeof(blob), f);
+  fclose(f);
+  return game_restore(self, blob, size);
+}
+
+uint64_t game_tick(const struct game_state * self) {
+  return (uint64_t)(self->time * 1000); // TODO is this ported right?
+}
+
+static const struct map_data * loaded_map(const struct world * world, int map) {
+  if(!world->maps[map]) { printf("map %s is not loaded\n", world->nodes[map].filename); exit(EXIT_FAILURE); }
+  return world->maps[map];
+}
+
+struct game_events game_step(struct game_state * self, const struct world * world, uint8_t keys, uint8_t previous_keys, double delta_time) {
+  struct game_events events = {NO_SOUND, false, false, false};
+  const struct rect collision = PRINCESS_COLLISION;
+  self->time += delta_time;
+  uint64_t tick = game_tick(self);
+
+  // change map
+  if(self->next_map != -1) {
+    const struct map_data * next = loaded_map(world, self->next_map);
+    if(next->has_spawn && (self->warping || self->map == -1)) {
+      self->px = next->spawn_x - collision.w/2 - collision.x;
+      self->py = next->spawn_y - collision.h/2 - collision.y;
+    }
+    self->item = self->ignored_items[next->item]? NO_ITEM : next->item;
+    self->npc = self->ignored_npcs[next->npc]? NO_NPC : next->npc;
+    self->npc_t0 = tick;
+    self->map = self->next_map;
+    self->next_map = -1;
+    self->warping = false;
+  }
+  const struct map_data * map = loaded_map(world, self->map);
+  const struct map_node * node = &world->nodes[self->map];
+
+  // walking
+  double lx = 0, ly = 0;
+  if((keys >> DOWN) & 1) ly = fmin(1, ly + 1);
+  if((keys >> UP) & 1) ly = fmax(-1, ly - 1);
+  if((keys >> RIGHT) & 1) lx = fmin(1, lx + 1);
+  if((keys >> LEFT) & 1) lx = fmax(-1, lx - 1);
+  if(lx != 0 || ly != 0) {
+    // up/down
+    if(fabs(ly) > fabs(lx)) {
+      self->facing_index = (ly < 0)? 2 : 0;
+      self->facing_mirror = false;
+      self->forward.y = self->py + collision.y + ((ly < 0)? -self->forward.h : collision.h);
+      self->forward.x = self->px + collision.x - (self->forward.w - collision.w) / 2;
+    }
+    // left/right
+    else {
+      self->facing_index = 1;
+      self->facing_mirror = lx < 0; // left is right mirrored
+      self->forward.y = self->py + collision.y - (self->forward.h - collision.h) / 2;
+      self->forward.x = self->px + collision.x + ((lx < 0)? -self->forward.w: collision.w);
+    }
+    self->walking = true;
+  } else {
+    self->walking = false;
+    self->walking_t0 = tick;
+  }
+  // collision
+  {
+    // sweep the collision box along the whole motion, so neither speed nor frame time can tunnel through walls
+    struct rect box = {self->px + collision.x, self->py + collision.y, collision.w, collision.h};
+    double dx = delta_time * STEP_PER_SECONDS * lx;
+    double dy = delta_time * STEP_PER_SECONDS * ly;
+    struct body bodies[3];
+    int body_count = 0;
+    if(map->warp != -1) bodies[body_count++] = (struct body){map->warp_rect, BODY_TRIGGER};
+    if(self->item) bodies[body_count++] = (struct body){map->item_rect, BODY_SOLID};
+    if(NPC_SOLID[self->npc]) bodies[body_count++] = (struct body){map->npc_rect, BODY_SOLID};
+    struct sweep_world sweep = {&map->solid[0][0], MAP_COL, MAP_ROW, TS, {node->north != -1, node->south != -1, node->east != -1, node->west != -1}, bodies, body_count};
+    struct sweep hit;
+    if(slide_box(&sweep, &box, dx, dy, &hit)) {
+      // the warp is only reached if no wall comes first, even when sliding into it
+      self->next_map = map->warp;
+      self->warping = true;
+    } else {
+      self->px = box.x - collision.x;
+      self->py = box.y - collision.y;
+      // walked off the screen
+      if(box.x < 0 && node->west != -1) { self->next_map = node->west; self->px += MAP_COL * TS - collision.w; }
+      else if(box.x + box.w >= MAP_COL * TS && node->east != -1) { self->next_map = node->east; self->px -= MAP_COL * TS - collision.w; }
+      else if(box.y < 0 && node->north != -1) { self->next_map = node->north; self->py += MAP_ROW * TS - collision.h; }
+      else if(box.y + box.h >= MAP_ROW * TS && node->south != -1) { self->next_map = node->south; self->py -= MAP_ROW * TS - collision.h; }
+    }
+  }
+  // action button (activate stuff forward, dismiss message box)
+  if(((previous_keys & ~keys) >> ACTION) & 1) {
+    events.action = true;
+    // dismiss dialog
+    if(self->message) {
+      self->message = NO_MESSAGE;
+      events.dismissed = true;
+    }
+    // pickup items
+    else if(self->item && collides_2D(&self->forward, &map->item_rect)) {
+      if(self->item != ITEM_WATER || self->held_item == ITEM_BOTTLE) {
+        self->held_item = self->item;
+        self->item = NO_ITEM;
+        self->ignored_items[self->held_item] = true;
+        if(self->held_item == ITEM_HEART) {
+          self->winner_t0 = tick;
+        }
+      }
+    }
+    // npc interaction
+    else if(self->npc && collides_2D(&self->forward, &map->npc_rect)) {
+      int npc_state = self->npc_state[self->npc];
+      if(self->npc == NPC_ELF) {
+        if(npc_state == 0) {
+          self->message = MSG_ELF_HUNGRY;
+          events.sound = SND_ELF_0;
+          self->npc_state[NPC_ELF] = 1;
+        } else {
+          if(self->held_item == ITEM_CANE) {
+            self->message = MSG_ELF_THANKS;
+            events.sound = SND_ELF_2;
+            self->held_item = NO_ITEM;
+            self->ignored_npcs[NPC_ELF] = true; self->npc = NO_NPC;
+            self->npc_state[NPC_ELF] = 2;
+          } else {
+            self->message = MSG_ELF_SO_HUNGRY;
+            events.sound = SND_ELF_1;
+          }
+        }
+      } else if(self->npc == NPC_BOTTLE) {
+        if(npc_state == 0) {
+          if(self->held_item == ITEM_KEY) {
+            self->message = MSG_CHEST_OPEN;
+            events.sound = SND_OPEN;
+            self->held_item = ITEM_BOTTLE;
+            self->npc_state[NPC_BOTTLE] = 1;
+          } else {
+            self->message = MSG_CHEST_LOCKED;
+            events.sound = SND_LOCKED;
+          }
+        } else if(npc_state == 1) {
+          self->message = MSG_CHEST_EMPTY;
+          events.sound = SND_EMPTY;
+        }
+      } else if(self->npc == NPC_FLAME) {
+        if(npc_state == 0) {
+          if(self->held_item == ITEM_WATER) {
+            self->message = MSG_FLAME;
+            events.sound = SND_FLAME;
+            self->held_item = ITEM_STAFF;
+            self->ignored_npcs[NPC_FLAME] = true; self->npc = NO_NPC;
+            self->npc_state[NPC_FLAME] = 1;
+          }
+        }
+      } else if(self->npc == NPC_WIZARD) {
+        if(npc_state == 1 && self->held_item == ITEM_STAFF) {
+          self->message = MSG_WIZARD_SPELL;
+          events.sound = SND_WIZ_1;
+          self->npc_state[NPC_WIZARD] = 2;
+          self->held_item = ITEM_SPELL;
+        } else {
+          if(npc_state == 2) {
+            self->message = MSG_WIZARD_THANKS;
+            events.sound = SND_WIZ_2;
+          } else {
+            self->message = MSG_WIZARD_HELP;
+            events.sound = SND_WIZ_0;
+            if(npc_state == 0) self->npc_state[NPC_WIZARD] = 1;
+          }
+        }
+      } else if(self->npc == NPC_GARDEN) {
+        self->message = MSG_GARDEN;
+        events.sound = SND_GARDEN;
+      } else if(self->npc == NPC_DRAGON) {
+        if(self->held_item == ITEM_SPELL) {
+          self->ignored_npcs[NPC_DRAGON] = true;
+          self->npc = NPC_KABOOM;
+          self->npc_t0 = tick;
+          self->held_item = NO_ITEM;
+          events.kaboom = true;
+        }
+      }
+    }
+  }
+  // kaboom plays once, then the dragon is gone
+  if(self->npc == NPC_KABOOM && tick >= self->npc_t0 + KABOOM_DURATION) self->npc = NO_NPC;
+  return events;
+}
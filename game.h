@@ -0,0 +1,68 @@
+#pragma once
+// Copyright 2023 David Lareau. This program is free software under the terms of the Zero Clause BSD.
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "world.h"
+
+enum message { NO_MESSAGE, MSG_ELF_HUNGRY, MSG_ELF_THANKS, MSG_ELF_SO_HUNGRY, MSG_CHEST_OPEN, MSG_CHEST_LOCKED, MSG_CHEST_EMPTY, MSG_FLAME, MSG_WIZARD_SPELL, MSG_WIZARD_THANKS, MSG_WIZARD_HELP, MSG_GARDEN, MESSAGE_COUNT };
+extern const char * MESSAGES[MESSAGE_COUNT];
+
+// played by the step, the simulation only says which
+enum sound { NO_SOUND, SND_ELF_0, SND_ELF_1, SND_ELF_2, SND_OPEN, SND_LOCKED, SND_EMPTY, SND_FLAME, SND_WIZ_0, SND_WIZ_1, SND_WIZ_2, SND_GARDEN, SOUND_COUNT };
+extern const char * SOUND_FILES[SOUND_COUNT];
+
+// virtual keys, one bit each in a keys mask
+enum vk { LEFT, RIGHT, ACTION, UP, DOWN };
+
+enum { KABOOM_DURATION = 1000 };
+extern const struct rect PRINCESS_COLLISION; // relative to the player position
+
+// all of the simulation, flat and pointer-free so a snapshot is a plain copy
+struct game_state {
+  double time; // seconds simulated
+  // map
+  int map; // index in world
+  int next_map; // -1 unless changing map this frame
+  bool warping;
+  enum item item; // lying on the current map
+  enum npc npc; // standing on the current map
+  // player
+  double px;
+  double py;
+  struct rect forward;
+  int facing_index; // 0 down, 1 side, 2 up
+  bool facing_mirror; // side facing left
+  bool walking;
+  uint64_t walking_t0; // tick the walk started, or the current tick while standing
+  enum item held_item;
+  // quest
+  uint8_t npc_state[NPC_COUNT];
+  bool ignored_items[ITEM_COUNT];
+  bool ignored_npcs[NPC_COUNT];
+  enum message message;
+  uint64_t npc_t0; // tick the npc showed up, what its animation and the kaboom run from
+  uint64_t winner_t0;
+};
+
+void game_init(struct game_state * self);
+uint64_t game_tick(const struct game_state * self); // milliseconds simulated, what animations run on
+
+// what happened during a step that the state doesn't keep
+struct game_events {
+  enum sound sound;
+  bool action; // the action key was released
+  bool dismissed; // and it closed the message box
+  bool kaboom; // the dragon was just blown up
+};
+
+// advances the simulation by delta_time with keys held, and previous_keys held on the step before
+// only reads the world, whose maps must all be loaded, so instances can share it across threads
+struct game_events game_step(struct game_state * self, const struct world * world, uint8_t keys, uint8_t previous_keys, double delta_time);
+
+// snapshot blob is a small header followed by the state
+size_t game_snapshot_size(void);
+void game_snapshot(const struct game_state * self, void * blob);
+bool game_restore(struct game_state * self, const void * blob, size_t size);
+bool game_save(const struct game_state * self, const char * filename);
+bool game_load(struct game_state * self, const char * filename);
@@ -0,0 +1,174 @@
+// Copyright 2023 David Lareau. This program is free software under the terms of the Zero Clause BSD.
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/ioctl.h>
+#include <linux/input.h>
+#include "input.h"
+#include "game.h"
+#include "time-util.h"
+
+static bool test_bit(const uint8_t * bits, int bit) {
+  return (bits[bit / 8] >> (bit % 8)) & 1;
+}
+
+static void set_bit(uint8_t * bits, int bit, bool value) {
+  if(value) bits[bit / 8] |= 1 << (bit % 8);
+  else bits[bit / 8] &= ~(1 << (bit % 8));
+}
+
+static bool open_device(struct input_device * self, const char * name) {
+  char filename[300]; snprintf(filename, sizeof(filename), "/dev/input/%s", name);
+  snprintf(self->name, sizeof(self->name), "%s", name);
+  self->fd = open(filename, O_RDONLY | O_NONBLOCK);
+  if(self->fd == -1) return false;
+  uint8_t keys[KEY_CNT / 8] = {0};
+  if(ioctl(self->fd, EVIOCGBIT(EV_KEY, sizeof(keys)), keys) < 0) { close(self->fd); return false; }
+  self->gamepad = test_bit(keys, BTN_SOUTH);
+  if(!self->gamepad && !test_bit(keys, KEY_SPACE)) { close(self->fd); return false; } // neither keyboard nor gamepad
+  // timestamps on the same clock as the game's
+  int clock = CLOCK_MONOTONIC;
+  ioctl(self->fd, EVIOCSCLOCKID, &clock);
+  self->trusted = !self->gamepad;
+  memset(self->down, 0, sizeof(self->down));
+  self->x = self->y = self->hat_x = self->hat_y = 0;
+  struct input_absinfo info;
+  if(ioctl(self->fd, EVIOCGABS(ABS_X), &info) == 0) { self->x_min = info.minimum; self->x_max = info.maximum; self->x = (info.minimum + info.maximum) / 2; }
+  else self->x_min = self->x_max = 0;
+  if(ioctl(self->fd, EVIOCGABS(ABS_Y), &info) == 0) { self->y_min = info.minimum; self->y_max = info.maximum; self->y = (info.minimum + info.maximum) / 2; }
+  else self->y_min = self->y_max = 0;
+  return true;
+}
+
+// axis value mapped to -1..1
+static double normalized(int value, int min, int max) {
+  return (max > min)? 2.0 * (value - min) / (max - min) - 1 : 0;
+}
+
+static uint8_t device_keys(const struct input_device * self) {
+  if(!self->trusted) return 0;
+  const uint8_t * d = self->down;
+  double x = normalized(self->x, self->x_min, self->x_max);
+  double y = normalized(self->y, self->y_min, self->y_max);
+  uint8_t keys = 0;
+  if(test_bit(d, KEY_LEFT) || test_bit(d, KEY_A) || test_bit(d, BTN_DPAD_LEFT) || self->hat_x < 0 || x <= -.4) keys |= 1 << LEFT;
+  if(test_bit(d, KEY_RIGHT) || test_bit(d, KEY_D) || test_bit(d, BTN_DPAD_RIGHT) || self->hat_x > 0 || x >= .4) keys |= 1 << RIGHT;
+  if(test_bit(d, KEY_UP) || test_bit(d, KEY_W) || test_bit(d, BTN_DPAD_UP) || self->hat_y < 0 || y <= -.4) keys |= 1 << UP;
+  if(test_bit(d, KEY_DOWN) || test_bit(d, KEY_S) || test_bit(d, BTN_DPAD_DOWN) || self->hat_y > 0 || y >= .4) keys |= 1 << DOWN;
+  if(test_bit(d, KEY_SPACE) || test_bit(d, KEY_X) || test_bit(d, BTN_SOUTH) || test_bit(d, BTN_EAST)) keys |= 1 << ACTION;
+  return keys;
+}
+
+static void push(struct input * self, double time, uint8_t keys) {
+  size_t head = atomic_load_explicit(&self->head, memory_order_relaxed);
+  if(head - atomic_load_explicit(&self->tail, memory_order_acquire) == INPUT_QUEUE_CAPACITY) { atomic_fetch_add(&self->dropped, 1); return; }
+  self->ring[head % INPUT_QUEUE_CAPACITY] = (struct key_edge){time, keys};
+  atomic_store_explicit(&self->head, head + 1, memory_order_release);
+}
+
+bool input_pop(struct input * self, struct key_edge * edge) {
+  size_t tail = atomic_load_explicit(&self->tail, memory_order_relaxed);
+  if(tail == atomic_load_explicit(&self->head, memory_order_acquire)) return false;
+  *edge = self->ring[tail % INPUT_QUEUE_CAPACITY];
+  atomic_store_explicit(&self->tail, tail + 1, memory_order_release);
+  return true;
+}
+
+static void push_keys(struct input * self, double time) {
+  uint8_t keys = 0;
+  for(int j = 0; j < self->device_count; j++) keys |= device_keys(&self->devices[j]);
+  if(keys != self->keys) {
+    self->keys = keys;
+    push(self, time, keys);
+  }
+}
+
+// drains whatever the device has, a complete report at a time, returns false once the device is gone
+static bool read_device(struct input * self, struct input_device * device) {
+  struct input_event events[64];
+  ssize_t n;
+  while((n = read(device->fd, events, sizeof(events))) > 0) {
+    for(int i = 0; i < n / (ssize_t)sizeof(struct input_event); i++) {
+      const struct input_event * e = &events[i];
+      if(e->type == EV_KEY && e->code < KEY_CNT) {
+        set_bit(device->down, e->code, e->value != 0); // 2 is autorepeat, still held
+        if(e->value && (e->code == BTN_SOUTH || e->code == BTN_EAST || e->code == BTN_NORTH || e->code == BTN_WEST || e->code == BTN_SELECT || e->code == BTN_START)) device->trusted = true;
+      } else if(e->type == EV_ABS) {
+        if(e->code == ABS_X) device->x = e->value;
+        else if(e->code == ABS_Y) device->y = e->value;
+        else if(e->code == ABS_HAT0X) device->hat_x = e->value;
+        else if(e->code == ABS_HAT0Y) device->hat_y = e->value;
+      } else if(e->type == EV_SYN && e->code == SYN_REPORT) {
+        push_keys(self, e->input_event_sec + e->input_event_usec / 1e6);
+      }
+    }
+  }
+  return !(n < 0 && errno == ENODEV);
+}
+
+static int event_filter(const struct dirent * entry) {
+  return strncmp(entry->d_name, "event", 5) == 0;
+}
+
+// opens the keyboards and gamepads not opened yet
+static void scan(struct input * self) {
+  struct dirent ** entries;
+  int n = scandir("/dev/input", &entries, event_filter, alphasort);
+  for(int i = 0; i < n; i++) {
+    bool known = false;
+    for(int j = 0; j < self->device_count && !known; j++) known = strcmp(self->devices[j].name, entries[i]->d_name) == 0;
+    if(!known && self->device_count < INPUT_DEVICES_CAPACITY && open_device(&self->devices[self->device_count], entries[i]->d_name)) self->device_count++;
+    free(entries[i]);
+  }
+  if(n >= 0) free(entries);
+}
+
+static void * sample(void * arg) {
+  struct input * self = arg;
+  struct timespec next;
+  clock_gettime(CLOCK_MONOTONIC, &next);
+  long period = self->period * 1e9;
+  double next_scan = now() + INPUT_RESCAN_PERIOD;
+  while(atomic_load(&self->running)) {
+    for(int i = 0; i < self->device_count; i++) {
+      if(read_device(self, &self->devices[i])) continue;
+      // unplugged, whatever it held is released
+      close(self->devices[i].fd);
+      self->devices[i--] = self->devices[--self->device_count];
+      push_keys(self, now());
+    }
+    if(now() >= next_scan) {
+      scan(self);
+      next_scan = now() + INPUT_RESCAN_PERIOD;
+    }
+    // absolute deadlines, so the rate doesn't drift with the time spent reading
+    next.tv_nsec += period;
+    while(next.tv_nsec >= 1000000000) { next.tv_nsec -= 1000000000; next.tv_sec++; }
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+  }
+  return NULL;
+}
+
+bool input_start(struct input * self, double rate) {
+  self->device_count = 0;
+  self->keys = 0;
+  self->period = 1 / rate;
+  atomic_init(&self->head, 0);
+  atomic_init(&self->tail, 0);
+  atomic_init(&self->dropped, 0);
+  scan(self);
+  if(!self->device_count) return false;
+  atomic_init(&self->running, true);
+  if(pthread_create(&self->thread, NULL, sample, self)) { printf("pthread_create() failed.\n"); exit(EXIT_FAILURE); }
+  return true;
+}
+
+void input_stop(struct input * self) {
+  atomic_store(&self->running, false);
+  pthread_join(self->thread, NULL);
+  for(int i = 0; i < self->device_count; i++) close(self->devices[i].fd);
+}
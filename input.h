@@ -0,0 +1,50 @@
+#pragma once
+// Copyright 2023 David Lareau. This program is free software under the terms of the Zero Clause BSD.
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+// keyboards and gamepads read straight from linux evdev (/dev/input/event*) by a thread sampling at a fixed rate (e.g. 1kHz)
+// - raylib only sees input when the main thread polls, once per frame, so edges show up as soon as they happen instead
+// - every change of the virtual keys mask goes in a lock-free single producer single consumer ring, with its kernel timestamp
+// - same bindings as vk_key() in main, gamepads are also ignored until a face button is pressed on them
+// - devices are read whether the window has focus or not, that's for the consumer to filter
+// - /dev/input is scanned again every INPUT_RESCAN_PERIOD seconds, so devices plugged in later are picked up, and unplugged ones dropped
+// - needs read access to the devices (usually the input group), input_start() returns false if none could be opened
+
+struct key_edge {
+  double time; // CLOCK_MONOTONIC seconds
+  uint8_t keys; // held from then on, one bit per enum vk
+};
+
+enum { INPUT_DEVICES_CAPACITY = 16, INPUT_QUEUE_CAPACITY = 256 }; // queue capacity is a power of two
+#define INPUT_RESCAN_PERIOD 1.0
+
+struct input_device {
+  char name[16]; // e.g. event3, in /dev/input
+  int fd;
+  bool gamepad;
+  bool trusted;
+  uint8_t down[96]; // bitset of held evdev key codes (KEY_CNT bits)
+  int x, y, hat_x, hat_y; // axis values
+  int x_min, x_max, y_min, y_max;
+};
+
+struct input {
+  pthread_t thread;
+  atomic_bool running;
+  double period;
+  int device_count;
+  struct input_device devices[INPUT_DEVICES_CAPACITY];
+  uint8_t keys; // thread side
+  // the thread only writes head, the consumer only writes tail
+  struct key_edge ring[INPUT_QUEUE_CAPACITY];
+  atomic_size_t head;
+  atomic_size_t tail;
+  atomic_ullong dropped; // edges lost to a full ring
+};
+
+bool input_start(struct input * self, double rate);
+void input_stop(struct input * self);
+bool input_pop(struct input * self, struct key_edge * edge); // oldest edge not yet popped, consumer thread only
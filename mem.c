@@ -0,0 +1,144 @@
+// Copyright 2023 David Lareau. This program is free software under the terms of the Zero Clause BSD.
+#define _GNU_SOURCE // for reallocarray on raspberry pi OS which has old libc
+#include <string.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include <libxml/xmlmemory.h>
+#include "mem.h"
+
+const char * MEM_TAG_NAMES[MEM_TAG_COUNT] = {"other", "dict", "xml", "world", "path", "replay", "render", "texture", "audio", "anim"};
+
+static atomic_llong current[MEM_TAG_COUNT];
+static atomic_llong peak[MEM_TAG_COUNT];
+static atomic_llong total;
+static atomic_llong total_peak;
+
+// in front of every block, sized so the payload keeps malloc's alignment
+union header {
+  struct {
+    size_t size;
+    enum mem_tag tag;
+  } block;
+  max_align_t align;
+};
+
+static void raise_peak(atomic_llong * p, long long value) {
+  long long seen = atomic_load(p);
+  while(value > seen && !atomic_compare_exchange_weak(p, &seen, value));
+}
+
+void mem_add(enum mem_tag tag, long long bytes) {
+  raise_peak(&peak[tag], atomic_fetch_add(&current[tag], bytes) + bytes);
+  raise_peak(&total_peak, atomic_fetch_add(&total, bytes) + bytes);
+}
+
+void * mem_alloc(enum mem_tag tag, size_t size) {
+  union header * h = malloc(sizeof(union header) + size);
+  if(!h) return NULL;
+  h->block.size = size;
+  h->block.tag = tag;
+  mem_add(tag, size);
+  return h + 1;
+}
+
+void * mem_calloc(enum mem_tag tag, size_t count, size_t size) {
+  if(size && count > SIZE_MAX / size) return NULL;
+  void * p = mem_alloc(tag, count * size);
+  if(p) memset(p, 0, count * size);
+  return p;
+}
+
+void * mem_realloc(enum mem_tag tag, void * p, size_t count, size_t size) {
+  if(size && count > SIZE_MAX / size) return NULL;
+  if(!p) return mem_alloc(tag, count * size);
+  union header * h = (union header *)p - 1;
+  size_t old_size = h->block.size;
+  enum mem_tag old_tag = h->block.tag;
+  h = realloc(h, sizeof(union header) + count * size);
+  if(!h) return NULL;
+  // remove before adding, so moving a block doesn't count as a peak
+  mem_add(old_tag, -(long long)old_size);
+  h->block.size = count * size;
+  h->block.tag = tag;
+  mem_add(tag, count * size);
+  return h + 1;
+}
+
+char * mem_strdup(enum mem_tag tag, const char * s) {
+  size_t size = strlen(s) + 1;
+  char * p = mem_alloc(tag, size);
+  if(p) memcpy(p, s, size);
+  return p;
+}
+
+void mem_free(void * p) {
+  if(!p) return;
+  union header * h = (union header *)p - 1;
+  mem_add(h->block.tag, -(long long)h->block.size);
+  free(h);
+}
+
+static void * xml_malloc(size_t size) {
+  return mem_alloc(MEM_XML, size);
+}
+
+static void * xml_realloc(void * p, size_t size) {
+  return mem_realloc(MEM_XML, p, 1, size);
+}
+
+static char * xml_strdup(const char * s) {
+  return mem_strdup(MEM_XML, s);
+}
+
+void mem_track_xml(void) {
+  if(xmlMemSetup(mem_free, xml_malloc, xml_realloc, xml_strdup) != 0) { printf("xmlMemSetup() failed.\n"); exit(EXIT_FAILURE); }
+}
+
+long long mem_current(enum mem_tag tag) {
+  return atomic_load(&current[tag]);
+}
+
+long long mem_peak(enum mem_tag tag) {
+  return atomic_load(&peak[tag]);
+}
+
+long long mem_total(void) {
+  return atomic_load(&total);
+}
+
+long long mem_total_peak(void) {
+  return atomic_load(&total_peak);
+}
+
+// marks come from the main thread only, and their own storage isn't tracked so it doesn't show up in the deltas
+struct mark {
+  const char * label;
+  long long delta;
+};
+static size_t marks_capacity;
+static size_t marks_size;
+static struct mark * marks;
+static long long marked_total;
+
+void mem_mark(const char * label) {
+  if(marks_size == marks_capacity) {
+    marks_capacity = marks_capacity? marks_capacity * 2 : 64;
+    marks = reallocarray(marks, marks_capacity, sizeof(struct mark));
+    if(!marks) { printf("out of mem\n"); exit(EXIT_FAILURE); }
+  }
+  long long now = mem_total();
+  marks[marks_size++] = (struct mark){label, now - marked_total};
+  marked_total = now;
+}
+
+long long mem_last_delta(void) {
+  return marks_size? marks[marks_size - 1].delta : 0;
+}
+
+void mem_report(FILE * f) {
+  fprintf(f, "memory      current KB    peak KB\n");
+  for(int i = 0; i < MEM_TAG_COUNT; i++) fprintf(f, "  %-8s %10.1f %10.1f\n", MEM_TAG_NAMES[i], mem_current(i) / 1024.0, mem_peak(i) / 1024.0);
+  fprintf(f, "  %-8s %10.1f %10.1f\n", "total", mem_total() / 1024.0, mem_total_peak() / 1024.0);
+  if(marks_size) fprintf(f, "deltas KB\n");
+  for(size_t i = 0; i < marks_size; i++) fprintf(f, "  %+10.1f %s\n", marks[i].delta / 1024.0, marks[i].label);
+}
@@ -0,0 +1,33 @@
+#pragma once
+// Copyright 2023 David Lareau. This program is free software under the terms of the Zero Clause BSD.
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// memory accounting by subsystem
+// - heap blocks from the mem_* functions carry a small header with their size and tag
+// - libxml2 goes through them after mem_track_xml()
+// - memory that isn't ours to allocate (gpu textures, decoded audio) is estimated and added with mem_add()
+// counters are atomic, so threads can allocate freely
+
+enum mem_tag { MEM_OTHER, MEM_DICT, MEM_XML, MEM_WORLD, MEM_PATH, MEM_REPLAY, MEM_RENDER, MEM_TEXTURE, MEM_AUDIO, MEM_ANIM, MEM_TAG_COUNT };
+extern const char * MEM_TAG_NAMES[MEM_TAG_COUNT];
+
+void * mem_alloc(enum mem_tag tag, size_t size);
+void * mem_calloc(enum mem_tag tag, size_t count, size_t size);
+void * mem_realloc(enum mem_tag tag, void * p, size_t count, size_t size); // like reallocarray, the block takes the new tag
+char * mem_strdup(enum mem_tag tag, const char * s);
+void mem_free(void * p);
+void mem_add(enum mem_tag tag, long long bytes);
+void mem_track_xml(void); // before any other libxml2 call
+
+long long mem_current(enum mem_tag tag);
+long long mem_peak(enum mem_tag tag);
+long long mem_total(void);
+long long mem_total_peak(void);
+
+// remembers how much the total moved since the previous mark, e.g. across map transitions
+void mem_mark(const char * label); // label must outlive the marks
+long long mem_last_delta(void);
+void mem_report(FILE * f);
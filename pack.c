@@ -0,0 +1,76 @@
+// Copyright 2023 David Lareau. This program is free software under the terms of the Zero Clause BSD.
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "pack.h"
+
+static const uint8_t * base;
+static size_t length;
+
+static const struct pack_header * header(void) {
+  return (const struct pack_header *)base;
+}
+
+static const struct pack_entry * slots(void) {
+  return (const struct pack_entry *)(base + sizeof(struct pack_header));
+}
+
+bool pack_mount(const char * filename) {
+  int fd = open(filename, O_RDONLY);
+  if(fd == -1) return false;
+  struct stat st;
+  if(fstat(fd, &st) == -1) { printf("fstat(%s) failed.\n", filename); exit(EXIT_FAILURE); }
+  length = st.st_size;
+  if(length < sizeof(struct pack_header)) { printf("%s is not a pack.\n", filename); exit(EXIT_FAILURE); }
+  base = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if(base == MAP_FAILED) { printf("mmap(%s) failed.\n", filename); exit(EXIT_FAILURE); }
+  const struct pack_header * h = header();
+  if(memcmp(h->magic, "ZPAK", 4) != 0 || h->version != PACK_VERSION) { printf("%s is not a version %d pack.\n", filename, PACK_VERSION); exit(EXIT_FAILURE); }
+  if(h->slot_count == 0 || (h->slot_count & (h->slot_count - 1)) || h->entry_count > h->slot_count / 2 || (length - sizeof(struct pack_header)) / sizeof(struct pack_entry) < h->slot_count) { printf("%s has a bad index.\n", filename); exit(EXIT_FAILURE); }
+  // the whole pack is checked now, which also pages it in
+  uint32_t found = 0;
+  for(uint32_t i = 0; i < h->slot_count; i++) {
+    const struct pack_entry * e = &slots()[i];
+    if(!e->name_length) continue;
+    found++;
+    if(e->name > length || e->name_length > length - e->name || e->offset > length || e->size > length - e->offset) { printf("%s: entry %u is out of bounds.\n", filename, i); exit(EXIT_FAILURE); }
+    if(pack_hash(base + e->name, e->name_length) != e->hash) { printf("%s: entry %u has a bad name hash.\n", filename, i); exit(EXIT_FAILURE); }
+    if(pack_hash(base + e->offset, e->size) != e->checksum) { printf("%s: %.*s is corrupt.\n", filename, (int)e->name_length, base + e->name); exit(EXIT_FAILURE); }
+  }
+  if(found != h->entry_count) { printf("%s has %u entries, expected %u.\n", filename, found, h->entry_count); exit(EXIT_FAILURE); }
+  return true;
+}
+
+void pack_unmount(void) {
+  if(!base) return;
+  munmap((void *)base, length);
+  base = NULL;
+  length = 0;
+}
+
+const void * pack_get(const char * name, size_t * size) {
+  if(!base) return NULL;
+  size_t name_length = strlen(name);
+  uint64_t hash = pack_hash(name, name_length);
+  uint32_t mask = header()->slot_count - 1;
+  // linear probing, the table is never full
+  for(uint32_t i = hash & mask; ; i = (i + 1) & mask) {
+    const struct pack_entry * e = &slots()[i];
+    if(!e->name_length) return NULL;
+    if(e->hash == hash && e->name_length == name_length && memcmp(base + e->name, name, name_length) == 0) {
+      if(size) *size = e->size;
+      return base + e->offset;
+    }
+  }
+}
+
+xmlDoc * pack_xml(const char * name) {
+  size_t size;
+  const void * data = pack_get(name, &size);
+  if(!data) return xmlParseFile(name);
+  return xmlReadMemory(data, size, name, NULL, 0);
+}
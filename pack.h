@@ -0,0 +1,46 @@
+#pragma once
+// Copyright 2023 David Lareau. This program is free software under the terms of the Zero Clause BSD.
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <libxml/parser.h>
+
+// all game assets in one file, built by zeldaish-pack (see tools/pack.c) and memory-mapped at runtime
+// - header, then an open addressing hash table of entries keyed by file name, then the names, then the file contents
+// - mounting checks every entry's bounds and checksum, so a broken pack fails at startup rather than mid-game
+// - while nothing is mounted, or for names not in the pack, loaders fall back to loose files
+
+enum { PACK_VERSION = 1 };
+
+struct pack_header {
+  char magic[4]; // ZPAK
+  uint32_t version;
+  uint32_t entry_count;
+  uint32_t slot_count; // power of two, at least twice entry_count
+};
+
+struct pack_entry {
+  uint64_t hash; // of the name
+  uint64_t offset; // of the content, from the start of the file
+  uint64_t size;
+  uint64_t checksum; // of the content
+  uint32_t name; // offset of the name, from the start of the file
+  uint32_t name_length; // 0 for an empty slot
+};
+
+// fnv-1a, for names and contents
+#define PACK_HASH_BASIS 0xCBF29CE484222325
+static inline uint64_t pack_hash_more(uint64_t hash, const void * data, size_t size) { // continues hash over more data
+  const uint8_t * p = data;
+  for(size_t i = 0; i < size; i++) hash = (hash ^ p[i]) * 0x100000001B3;
+  return hash;
+}
+
+static inline uint64_t pack_hash(const void * data, size_t size) {
+  return pack_hash_more(PACK_HASH_BASIS, data, size);
+}
+
+bool pack_mount(const char * filename); // false if the file can't be opened, exits if it's not a valid pack
+void pack_unmount(void);
+const void * pack_get(const char * name, size_t * size); // NULL when not packed, valid until unmount
+xmlDoc * pack_xml(const char * name); // parsed from the pack, or from the file when not packed
@@ -0,0 +1,120 @@
+// Copyright 2023 David Lareau. This program is free software under the terms of the Zero Clause BSD.
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "particle.h"
+#include "mem.h"
+
+void particles_init(struct particles * self, int capacity) {
+  self->capacity = capacity;
+  self->size = 0;
+  self->x = mem_alloc(MEM_RENDER, sizeof(float) * capacity);
+  self->y = mem_alloc(MEM_RENDER, sizeof(float) * capacity);
+  self->vx = mem_alloc(MEM_RENDER, sizeof(float) * capacity);
+  self->vy = mem_alloc(MEM_RENDER, sizeof(float) * capacity);
+  self->ay = mem_alloc(MEM_RENDER, sizeof(float) * capacity);
+  self->age = mem_alloc(MEM_RENDER, sizeof(float) * capacity);
+  self->life = mem_alloc(MEM_RENDER, sizeof(float) * capacity);
+  self->sprite = mem_alloc(MEM_RENDER, sizeof(uint16_t) * capacity);
+  if(!self->x || !self->y || !self->vx || !self->vy || !self->ay || !self->age || !self->life || !self->sprite) { printf("out of mem\n"); exit(EXIT_FAILURE); }
+  self->rng = 0x9E3779B9;
+}
+
+void particles_free(struct particles * self) {
+  mem_free(self->x);
+  mem_free(self->y);
+  mem_free(self->vx);
+  mem_free(self->vy);
+  mem_free(self->ay);
+  mem_free(self->age);
+  mem_free(self->life);
+  mem_free(self->sprite);
+}
+
+void particles_clear(struct particles * self) {
+  self->size = 0;
+}
+
+bool particles_emit(struct particles * self, float x, float y, float vx, float vy, float ay, float life, uint16_t sprite) {
+  if(self->size == self->capacity) return false;
+  int i = self->size++;
+  self->x[i] = x;
+  self->y[i] = y;
+  self->vx[i] = vx;
+  self->vy[i] = vy;
+  self->ay[i] = ay;
+  self->age[i] = 0;
+  self->life[i] = life;
+  self->sprite[i] = sprite;
+  return true;
+}
+
+// four lanes at a time with gcc vector extensions (sse on x86, neon on arm), so it doesn't depend on the optimization level
+typedef float float4 __attribute__((vector_size(16)));
+
+static inline float4 load4(const float * p) {
+  float4 v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline void store4(float * p, float4 v) {
+  memcpy(p, &v, sizeof(v));
+}
+
+void particles_update(struct particles * self, float delta_time) {
+  int n = self->size;
+  float * x = self->x, * y = self->y, * vx = self->vx, * vy = self->vy, * ay = self->ay, * age = self->age;
+  const float dt = delta_time;
+  const float4 dt4 = {dt, dt, dt, dt};
+  int i = 0;
+  for(; i + 4 <= n; i += 4) {
+    float4 v = load4(&vy[i]) + load4(&ay[i]) * dt4;
+    store4(&vy[i], v);
+    store4(&y[i], load4(&y[i]) + v * dt4);
+    store4(&x[i], load4(&x[i]) + load4(&vx[i]) * dt4);
+    store4(&age[i], load4(&age[i]) + dt4);
+  }
+  for(; i < n; i++) {
+    vy[i] += ay[i] * dt;
+    y[i] += vy[i] * dt;
+    x[i] += vx[i] * dt;
+    age[i] += dt;
+  }
+  // remove the dead, walking backward so a moved particle is one already checked
+  for(int i = n - 1; i >= 0; i--) {
+    if(age[i] < self->life[i]) continue;
+    int last = --n;
+    self->x[i] = self->x[last];
+    self->y[i] = self->y[last];
+    self->vx[i] = self->vx[last];
+    self->vy[i] = self->vy[last];
+    self->ay[i] = self->ay[last];
+    self->age[i] = self->age[last];
+    self->life[i] = self->life[last];
+    self->sprite[i] = self->sprite[last];
+  }
+  self->size = n;
+}
+
+static float random_unit(struct particles * self) {
+  self->rng ^= self->rng << 13;
+  self->rng ^= self->rng >> 17;
+  self->rng ^= self->rng << 5;
+  return (self->rng >> 8) / (float)(1 << 24);
+}
+
+void particles_ring(struct particles * self, float x, float y, float rx, float ry, int count, float life, uint16_t sprite) {
+  for(int i = 0; i < count; i++) {
+    double theta = 2 * M_PI * i / count;
+    particles_emit(self, x, y, rx * cos(theta) / life, ry * sin(theta) / life, 0, life, sprite);
+  }
+}
+
+void particles_burst(struct particles * self, float x, float y, float speed, float gravity, int count, float life, uint16_t sprite) {
+  for(int i = 0; i < count; i++) {
+    double theta = 2 * M_PI * random_unit(self);
+    double v = speed * (.25 + .75 * random_unit(self));
+    particles_emit(self, x, y, v * cos(theta), v * sin(theta), gravity, life * (.5 + .5 * random_unit(self)), sprite);
+  }
+}
@@ -0,0 +1,36 @@
+#pragma once
+// Copyright 2023 David Lareau. This program is free software under the terms of the Zero Clause BSD.
+#include <stdint.h>
+#include <stdbool.h>
+
+// cosmetic particles, stored as structure of arrays so the update is a handful of straight loops the compiler vectorizes
+// - each particle moves with its velocity and its own vertical acceleration, and dies once its age reaches its life
+// - dead particles are replaced by the last one, so the order isn't kept and the arrays stay packed
+// - the sprite is an id the caller draws however it likes
+// - emitting beyond capacity drops the new particles
+
+struct particles {
+  int capacity;
+  int size;
+  float * x;
+  float * y;
+  float * vx;
+  float * vy;
+  float * ay;
+  float * age; // seconds
+  float * life; // seconds
+  uint16_t * sprite;
+  uint32_t rng;
+};
+
+void particles_init(struct particles * self, int capacity);
+void particles_free(struct particles * self);
+void particles_clear(struct particles * self);
+void particles_update(struct particles * self, float delta_time);
+bool particles_emit(struct particles * self, float x, float y, float vx, float vy, float ay, float life, uint16_t sprite);
+
+// emitters
+// count particles evenly spaced on an ellipse, reaching (rx, ry) away from (x, y) at the end of their life
+void particles_ring(struct particles * self, float x, float y, float rx, float ry, int count, float life, uint16_t sprite);
+// count particles in random directions at up to speed pixels per second, falling with gravity, with lives from life/2 to life
+void particles_burst(struct particles * self, float x, float y, float speed, float gravity, int count, float life, uint16_t sprite);
@@ -0,0 +1,424 @@
+// Copyright 2023 David Lareau. This program is free software under the terms of the Zero Clause BSD.
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "path.h"
+#include "mem.h"
+
+enum { CELLS = MAP_ROW * MAP_COL };
+
+void path_init(struct path * self) {
+  self->capacity = 0;
+  self->size = 0;
+  self->cells = NULL;
+}
+
+void path_free(struct path * self) {
+  mem_free(self->cells);
+}
+
+static void path_push(struct path * self, int cell) {
+  if(self->size == self->capacity) {
+    self->capacity = self->capacity? self->capacity * 2 : 64;
+    self->cells = mem_realloc(MEM_PATH, self->cells, self->capacity, sizeof(int));
+    if(!self->cells) { printf("out of mem\n"); exit(EXIT_FAILURE); }
+  }
+  self->cells[self->size++] = cell;
+}
+
+void path_finder_init(struct path_finder * self) {
+  memset(self, 0, sizeof(struct path_finder));
+}
+
+void path_finder_free(struct path_finder * self) {
+  mem_free(self->opened);
+  mem_free(self->closed);
+  mem_free(self->g);
+  mem_free(self->parent);
+  mem_free(self->heap);
+}
+
+static void reserve(struct path_finder * self, int cells) {
+  if(cells > self->capacity) {
+    self->opened = mem_realloc(MEM_PATH, self->opened, cells, sizeof(uint32_t));
+    self->closed = mem_realloc(MEM_PATH, self->closed, cells, sizeof(uint32_t));
+    self->g = mem_realloc(MEM_PATH, self->g, cells, sizeof(int));
+    self->parent = mem_realloc(MEM_PATH, self->parent, cells, sizeof(int));
+    if(!self->opened || !self->closed || !self->g || !self->parent) { printf("out of mem\n"); exit(EXIT_FAILURE); }
+    self->capacity = cells;
+    self->generation = UINT32_MAX; // forces a clear below
+  }
+  // stamps let a query skip clearing, until they wrap around
+  if(self->generation == UINT32_MAX) {
+    memset(self->opened, 0, sizeof(uint32_t) * self->capacity);
+    memset(self->closed, 0, sizeof(uint32_t) * self->capacity);
+    self->generation = 0;
+  }
+  self->generation++;
+}
+
+static void heap_push(struct path_finder * self, uint64_t v) {
+  if(self->heap_size == self->heap_capacity) {
+    self->heap_capacity = self->heap_capacity? self->heap_capacity * 2 : 256;
+    self->heap = mem_realloc(MEM_PATH, self->heap, self->heap_capacity, sizeof(uint64_t));
+    if(!self->heap) { printf("out of mem\n"); exit(EXIT_FAILURE); }
+  }
+  size_t i = self->heap_size++;
+  while(i > 0) {
+    size_t parent = (i - 1) / 2;
+    if(self->heap[parent] <= v) break;
+    self->heap[i] = self->heap[parent];
+    i = parent;
+  }
+  self->heap[i] = v;
+}
+
+static uint64_t heap_pop(struct path_finder * self) {
+  uint64_t top = self->heap[0];
+  uint64_t last = self->heap[--self->heap_size];
+  size_t n = self->heap_size, i = 0;
+  if(n == 0) return top;
+  while(true) {
+    size_t child = 2 * i + 1;
+    if(child >= n) break;
+    if(child + 1 < n && self->heap[child + 1] < self->heap[child]) child++;
+    if(self->heap[child] >= last) break;
+    self->heap[i] = self->heap[child];
+    i = child;
+  }
+  self->heap[i] = last;
+  return top;
+}
+
+// goal cells, with their bounding box for the heuristic
+struct goal {
+  int cell; // when mask is null
+  const bool * mask;
+  int col0, row0, col1, row1;
+};
+
+static int octile(int dx, int dy) {
+  return (dx < dy)? 14 * dx + 10 * (dy - dx) : 14 * dy + 10 * (dx - dy);
+}
+
+// distance to the goal bounding box, which never overestimates
+static int heuristic(const struct goal * goal, int col, int row) {
+  int dx = (col < goal->col0)? goal->col0 - col : (col > goal->col1)? col - goal->col1 : 0;
+  int dy = (row < goal->row0)? goal->row0 - row : (row > goal->row1)? row - goal->row1 : 0;
+  return octile(dx, dy);
+}
+
+static const int DC[8] = {1, -1, 0, 0, 1, 1, -1, -1};
+static const int DR[8] = {0, 0, 1, -1, 1, -1, 1, -1};
+
+static bool search(struct path_finder * self, const struct path_grid * grid, int from, const struct goal * goal, struct path * out) {
+  const int cols = grid->cols, rows = grid->rows;
+  const bool * blocked = grid->blocked;
+  out->size = 0;
+  if(from < 0 || from >= cols * rows || blocked[from]) return false;
+  reserve(self, cols * rows);
+  const uint32_t gen = self->generation;
+  self->heap_size = 0;
+  self->opened[from] = gen;
+  self->g[from] = 0;
+  self->parent[from] = -1;
+  heap_push(self, (uint64_t)heuristic(goal, from % cols, from / cols) << 32 | (uint32_t)from);
+  while(self->heap_size) {
+    int cell = (int)(heap_pop(self) & UINT32_MAX);
+    // the heap keeps stale entries instead of decreasing keys
+    if(self->closed[cell] == gen) continue;
+    self->closed[cell] = gen;
+    if(goal->mask? goal->mask[cell] : cell == goal->cell) {
+      for(int c = cell; c != -1; c = self->parent[c]) path_push(out, c);
+      for(size_t i = 0; i < out->size / 2; i++) {
+        int swap = out->cells[i];
+        out->cells[i] = out->cells[out->size - 1 - i];
+        out->cells[out->size - 1 - i] = swap;
+      }
+      return true;
+    }
+    int col = cell % cols, row = cell / cols;
+    for(int i = 0; i < 8; i++) {
+      int c = col + DC[i], r = row + DR[i];
+      if(c < 0 || c >= cols || r < 0 || r >= rows) continue;
+      int next = r * cols + c;
+      if(blocked[next] || self->closed[next] == gen) continue;
+      bool diagonal = DC[i] && DR[i];
+      if(diagonal && (blocked[row * cols + c] || blocked[r * cols + col])) continue;
+      int g = self->g[cell] + (diagonal? 14 : 10);
+      if(self->opened[next] == gen && g >= self->g[next]) continue;
+      self->opened[next] = gen;
+      self->g[next] = g;
+      self->parent[next] = cell;
+      heap_push(self, (uint64_t)(g + heuristic(goal, c, r)) << 32 | (uint32_t)next);
+    }
+  }
+  return false;
+}
+
+bool path_find(struct path_finder * self, const struct path_grid * grid, int from, int to, struct path * out) {
+  out->size = 0;
+  if(to < 0 || to >= grid->cols * grid->rows || grid->blocked[to]) return false;
+  struct goal goal = {to, NULL, to % grid->cols, to / grid->cols, to % grid->cols, to / grid->cols};
+  return search(self, grid, from, &goal, out);
+}
+
+bool path_find_any(struct path_finder * self, const struct path_grid * grid, int from, const bool * goals, struct path * out) {
+  struct goal goal = {-1, goals, grid->cols, grid->rows, -1, -1};
+  for(int i = 0; i < grid->cols * grid->rows; i++) {
+    if(!goals[i] || grid->blocked[i]) continue;
+    int col = i % grid->cols, row = i / grid->cols;
+    if(col < goal.col0) goal.col0 = col;
+    if(col > goal.col1) goal.col1 = col;
+    if(row < goal.row0) goal.row0 = row;
+    if(row > goal.row1) goal.row1 = row;
+  }
+  out->size = 0;
+  if(goal.col1 == -1) return false;
+  return search(self, grid, from, &goal, out);
+}
+
+void route_init(struct route * self) {
+  self->capacity = 0;
+  self->size = 0;
+  self->steps = NULL;
+}
+
+void route_free(struct route * self) {
+  mem_free(self->steps);
+}
+
+static void route_push(struct route * self, int map, int cell, int leave) {
+  if(self->size == self->capacity) {
+    self->capacity = self->capacity? self->capacity * 2 : 64;
+    self->steps = mem_realloc(MEM_PATH, self->steps, self->capacity, sizeof(struct route_step));
+    if(!self->steps) { printf("out of mem\n"); exit(EXIT_FAILURE); }
+  }
+  self->steps[self->size++] = (struct route_step){map, cell, leave};
+}
+
+void path_world_init(struct path_world * self, struct world * world, struct rect box) {
+  self->world = world;
+  self->box = box;
+  self->span_w = fmax(1, ceil(box.w / TS));
+  self->span_h = fmax(1, ceil(box.h / TS));
+  self->screens = mem_calloc(MEM_PATH, world->map_count, sizeof(struct path_screen));
+  if(!self->screens) { printf("out of mem\n"); exit(EXIT_FAILURE); }
+  path_finder_init(&self->finder);
+  path_init(&self->scratch);
+  self->generation = 0;
+  self->queue_capacity = 0;
+  self->queue = NULL;
+}
+
+void path_world_free(struct path_world * self) {
+  mem_free(self->screens);
+  path_finder_free(&self->finder);
+  path_free(&self->scratch);
+  mem_free(self->queue);
+}
+
+void path_world_invalidate(struct path_world * self) {
+  for(int i = 0; i < self->world->map_count; i++) self->screens[i].valid = false;
+}
+
+int path_cell(const struct path_world * self, double px, double py) {
+  // the span of tiles centered on the box
+  int col = (int)floor((px + self->box.x + self->box.w / 2) / TS - (self->span_w - 1) / 2.0);
+  int row = (int)floor((py + self->box.y + self->box.h / 2) / TS - (self->span_h - 1) / 2.0);
+  if(col < 0) col = 0;
+  if(col > MAP_COL - self->span_w) col = MAP_COL - self->span_w;
+  if(row < 0) row = 0;
+  if(row > MAP_ROW - self->span_h) row = MAP_ROW - self->span_h;
+  return row * MAP_COL + col;
+}
+
+void path_position(const struct path_world * self, int cell, double * px, double * py) {
+  *px = (cell % MAP_COL) * TS + (self->span_w * TS - self->box.w) / 2 - self->box.x;
+  *py = (cell / MAP_COL) * TS + (self->span_h * TS - self->box.h) / 2 - self->box.y;
+}
+
+static void queue_push(struct path_world * self, size_t * size, int node) {
+  if(*size == self->queue_capacity) {
+    self->queue_capacity = self->queue_capacity? self->queue_capacity * 2 : 256;
+    self->queue = mem_realloc(MEM_PATH, self->queue, self->queue_capacity, sizeof(int));
+    if(!self->queue) { printf("out of mem\n"); exit(EXIT_FAILURE); }
+  }
+  self->queue[(*size)++] = node;
+}
+
+// tiles under a box standing on cell
+static struct rect span_rect(const struct path_world * self, int cell) {
+  return (struct rect){(cell % MAP_COL) * TS, (cell / MAP_COL) * TS, self->span_w * TS, self->span_h * TS};
+}
+
+// unlike collides_2D, touching isn't overlapping
+static bool overlaps(const struct rect * p, const struct rect * q) {
+  return p->x < q->x + q->w && q->x < p->x + p->w && p->y < q->y + q->h && q->y < p->y + p->h;
+}
+
+// items and npcs currently on a map, the visited one from the state, the others as they'll be found
+static struct path_screen * screen(struct path_world * self, const struct game_state * state, int map) {
+  const struct map_data * data = world_map(self->world, map);
+  enum item item = data->item;
+  enum npc npc = data->npc;
+  if(state && map == state->map) {
+    item = state->item;
+    npc = state->npc;
+  } else if(state) {
+    if(state->ignored_items[item]) item = NO_ITEM;
+    if(state->ignored_npcs[npc]) npc = NO_NPC;
+  }
+  struct path_screen * s = &self->screens[map];
+  if(s->valid && s->item == item && s->npc == npc) return s;
+  s->valid = true;
+  s->item = item;
+  s->npc = npc;
+  for(int i = 0; i < CELLS; i++) {
+    int col = i % MAP_COL, row = i / MAP_COL;
+    bool blocked = col + self->span_w > MAP_COL || row + self->span_h > MAP_ROW;
+    for(int r = row; !blocked && r < row + self->span_h; r++) {
+      for(int c = col; c < col + self->span_w; c++) blocked |= data->solid[r][c];
+    }
+    // bodies aren't aligned on tiles, so they are tested against the box itself, centered on the cell like path_position()
+    double px, py;
+    path_position(self, i, &px, &py);
+    struct rect box = {px + self->box.x, py + self->box.y, self->box.w, self->box.h};
+    if(item && overlaps(&box, &data->item_rect)) blocked = true;
+    if(NPC_SOLID[npc] && overlaps(&box, &data->npc_rect)) blocked = true;
+    s->blocked[i] = blocked;
+    s->component[i] = -1;
+    s->generation[i] = 0;
+  }
+  // flood fill with the same moves as the search, each cell is pushed at most once
+  int count = 0;
+  int stack[CELLS];
+  for(int i = 0; i < CELLS; i++) {
+    if(s->blocked[i] || s->component[i] != -1) continue;
+    int size = 0;
+    stack[size++] = i;
+    s->component[i] = count;
+    while(size) {
+      int cell = stack[--size];
+      int col = cell % MAP_COL, row = cell / MAP_COL;
+      for(int k = 0; k < 8; k++) {
+        int c = col + DC[k], r = row + DR[k];
+        if(c < 0 || c >= MAP_COL || r < 0 || r >= MAP_ROW) continue;
+        int next = r * MAP_COL + c;
+        if(s->blocked[next] || s->component[next] != -1) continue;
+        if(DC[k] && DR[k] && (s->blocked[row * MAP_COL + c] || s->blocked[r * MAP_COL + col])) continue;
+        s->component[next] = count;
+        stack[size++] = next;
+      }
+    }
+    count++;
+  }
+  return s;
+}
+
+// cell reached on the next map when leaving through exit from cell, or -1 if cell isn't on that exit
+static int crossing(struct path_world * self, int map, int exit, int cell) {
+  int col = cell % MAP_COL, row = cell / MAP_COL;
+  switch(exit) {
+    case NORTH: return (row == 0)? (MAP_ROW - self->span_h) * MAP_COL + col : -1;
+    case SOUTH: return (row == MAP_ROW - self->span_h)? col : -1;
+    case WEST: return (col == 0)? row * MAP_COL + MAP_COL - self->span_w : -1;
+    case EAST: return (col == MAP_COL - self->span_w)? row * MAP_COL : -1;
+  }
+  const struct map_data * data = world_map(self->world, map);
+  struct rect tiles = span_rect(self, cell);
+  if(!overlaps(&tiles, &data->warp_rect)) return -1;
+  const struct map_data * next = world_map(self->world, data->warp);
+  if(!next->has_spawn) return -1;
+  return path_cell(self, next->spawn_x - self->box.w / 2 - self->box.x, next->spawn_y - self->box.h / 2 - self->box.y);
+}
+
+static int next_map(struct path_world * self, int map, int exit) {
+  const struct map_node * node = &self->world->nodes[map];
+  switch(exit) {
+    case NORTH: return node->north;
+    case SOUTH: return node->south;
+    case EAST: return node->east;
+    case WEST: return node->west;
+  }
+  return world_map(self->world, map)->warp;
+}
+
+static void append(struct route * out, int map, const struct path * path, int exit) {
+  for(size_t i = 0; i < path->size; i++) route_push(out, map, path->cells[i], (i == path->size - 1)? exit : EXIT_NONE);
+}
+
+bool path_world_route(struct path_world * self, const struct game_state * state, int from_map, int from_cell, int to_map, int to_cell, struct route * out) {
+  out->size = 0;
+  struct path_screen * s = screen(self, state, from_map);
+  struct path_screen * t = screen(self, state, to_map);
+  if(s->component[from_cell] == -1 || t->component[to_cell] == -1) return false;
+  if(++self->generation == 0) {
+    for(int i = 0; i < self->world->map_count; i++) memset(self->screens[i].generation, 0, sizeof(self->screens[i].generation));
+    self->generation = 1;
+  }
+  const uint32_t gen = self->generation;
+
+  // breadth first search over (map, component)
+  int start = from_map * CELLS + s->component[from_cell];
+  int target = to_map * CELLS + t->component[to_cell];
+  s->generation[s->component[from_cell]] = gen;
+  s->from[s->component[from_cell]] = -1;
+  size_t head = 0, size = 0;
+  queue_push(self, &size, start);
+  bool found = start == target;
+  while(!found && head < size) {
+    int node = self->queue[head++];
+    int map = node / CELLS, component = node % CELLS;
+    for(int exit = 0; exit <= EXIT_WARP && !found; exit++) {
+      int next = next_map(self, map, exit);
+      if(next == -1) continue;
+      struct path_screen * a = &self->screens[map];
+      struct path_screen * b = screen(self, state, next);
+      for(int i = 0; i < CELLS && !found; i++) {
+        if(a->component[i] != component) continue;
+        int j = crossing(self, map, exit, i);
+        if(j == -1 || b->component[j] == -1) continue;
+        int other = b->component[j];
+        if(b->generation[other] == gen) continue;
+        b->generation[other] = gen;
+        b->from[other] = node;
+        b->exit[other] = exit;
+        queue_push(self, &size, next * CELLS + other);
+        found = next * CELLS + other == target;
+      }
+    }
+  }
+  if(!found) return false;
+
+  // nodes from start to target, reusing the queue
+  size = 0;
+  for(int node = target; node != -1; node = self->screens[node / CELLS].from[node % CELLS]) queue_push(self, &size, node);
+  for(size_t i = 0; i < size / 2; i++) {
+    int swap = self->queue[i];
+    self->queue[i] = self->queue[size - 1 - i];
+    self->queue[size - 1 - i] = swap;
+  }
+
+  // A* within each screen to a cell leading to the next node
+  int map = from_map, cell = from_cell;
+  for(size_t k = 1; k < size; k++) {
+    int next = self->queue[k] / CELLS, component = self->queue[k] % CELLS;
+    struct path_screen * a = &self->screens[map];
+    struct path_screen * b = &self->screens[next];
+    int exit = b->exit[component];
+    for(int i = 0; i < CELLS; i++) {
+      int j = (a->component[i] == a->component[cell])? crossing(self, map, exit, i) : -1;
+      self->goals[i] = j != -1 && b->component[j] == component;
+    }
+    struct path_grid grid = {MAP_COL, MAP_ROW, a->blocked};
+    if(!path_find_any(&self->finder, &grid, cell, self->goals, &self->scratch)) return false;
+    append(out, map, &self->scratch, exit);
+    cell = crossing(self, map, exit, self->scratch.cells[self->scratch.size - 1]);
+    map = next;
+  }
+  struct path_grid grid = {MAP_COL, MAP_ROW, self->screens[map].blocked};
+  if(!path_find(&self->finder, &grid, cell, to_cell, &self->scratch)) return false;
+  append(out, map, &self->scratch, EXIT_NONE);
+  return true;
+}
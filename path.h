@@ -0,0 +1,96 @@
+#pragma once
+// Copyright 2023 David Lareau. This program is free software under the terms of the Zero Clause BSD.
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "world.h"
+#include "game.h"
+
+// A* over a grid of cells, and routes across the world's screens on top of it
+
+struct path {
+  size_t capacity;
+  size_t size;
+  int * cells; // row * cols + col, from start to goal inclusive
+};
+
+void path_init(struct path * self);
+void path_free(struct path * self);
+
+struct path_grid {
+  int cols;
+  int rows;
+  const bool * blocked; // cols * rows
+};
+
+// scratch memory reused from query to query, so a query allocates nothing once warmed up
+struct path_finder {
+  int capacity; // cells
+  uint32_t generation;
+  uint32_t * opened; // generation in which g and parent were written
+  uint32_t * closed; // generation in which the cell was expanded
+  int * g;
+  int * parent;
+  size_t heap_capacity;
+  size_t heap_size;
+  uint64_t * heap; // f << 32 | cell
+};
+
+void path_finder_init(struct path_finder * self);
+void path_finder_free(struct path_finder * self);
+// 8-connected without cutting corners, 10 per straight step and 14 per diagonal step
+bool path_find(struct path_finder * self, const struct path_grid * grid, int from, int to, struct path * out);
+// same, to the closest cell set in goals
+bool path_find_any(struct path_finder * self, const struct path_grid * grid, int from, const bool * goals, struct path * out);
+
+// hierarchical layer: screens are split in connected components, and a breadth first search over
+// (screen, component) through screen edges and warps picks the screens, then A* stitches each screen
+enum { EXIT_NONE = -1, EXIT_WARP = 4 }; // or an enum edge
+
+struct route_step {
+  int map;
+  int cell;
+  int exit; // on the last cell of a screen, which way to walk to leave it
+};
+
+struct route {
+  size_t capacity;
+  size_t size;
+  struct route_step * steps;
+};
+
+void route_init(struct route * self);
+void route_free(struct route * self);
+
+// per screen cache, rebuilt when the items and npcs standing on that screen differ from when it was built
+struct path_screen {
+  bool valid;
+  enum item item;
+  enum npc npc;
+  bool blocked[MAP_ROW * MAP_COL]; // the box can't stand there
+  int component[MAP_ROW * MAP_COL]; // -1 when blocked
+  // breadth first search bookkeeping, per component
+  uint32_t generation[MAP_ROW * MAP_COL];
+  int from[MAP_ROW * MAP_COL]; // previous node, map * MAP_ROW * MAP_COL + component
+  int exit[MAP_ROW * MAP_COL]; // how the previous node was left
+};
+
+struct path_world {
+  struct world * world;
+  struct rect box; // collision box relative to the agent's position
+  int span_w, span_h; // tiles the box needs
+  struct path_screen * screens; // per map
+  struct path_finder finder;
+  struct path scratch;
+  uint32_t generation;
+  size_t queue_capacity;
+  int * queue;
+  bool goals[MAP_ROW * MAP_COL];
+};
+
+void path_world_init(struct path_world * self, struct world * world, struct rect box);
+void path_world_free(struct path_world * self);
+void path_world_invalidate(struct path_world * self); // forget all screens
+int path_cell(const struct path_world * self, double px, double py); // where an agent at px, py stands
+void path_position(const struct path_world * self, int cell, double * px, double * py); // agent position centered on cell
+bool path_world_route(struct path_world * self, const struct game_state * state, int from_map, int from_cell, int to_map, int to_cell, struct route * out);
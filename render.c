@@ -0,0 +1,609 @@
+// Copyright 2023 David Lareau. This program is free software under the terms of the Zero Clause BSD.
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <rlgl.h>
+#include "data-util.h"
+#include "render.h"
+#include "mem.h"
+#include "pack.h"
+#include "time-util.h"
+
+static void center_fit(double bounds_w, double bounds_h, double surface_w, double surface_h, double * out_scale, double * out_x, double * out_y) { if ((bounds_w / bounds_h) > (surface_w / surface_h)) *out_scale = bounds_h / surface_h; else *out_scale = bounds_w / surface_w; if(out_x) *out_x = (bounds_w - surface_w * *out_scale) / 2; if(out_y) *out_y = (bounds_h - surface_h * *out_scale) / 2; }
+
+static int W;
+static int H;
+static bool soft;
+static enum render_redraw redraw;
+static RenderTexture2D framebuffer;
+static Color * pixels;
+static struct dict images; // soft texture id -> Image (R8G8B8A8)
+static unsigned int next_id = 1;
+
+// draw calls are recorded between render_begin() and render_end(), then compared with the previous frame
+enum command_type { CMD_CLEAR, CMD_TEXTURE, CMD_RECTANGLE, CMD_TEXT, CMD_TILES };
+
+struct command {
+  enum command_type type;
+  Color color;
+  Texture2D texture;
+  Rectangle source; // a tile's size for tiles
+  Rectangle dest; // also the rectangle, the text position, and the tile grid
+  Font font;
+  float font_size;
+  float spacing;
+  size_t text; // offset in the list's text buffer
+  size_t tiles; // offset in the list's tile buffer
+  int columns, rows;
+};
+
+struct display_list {
+  size_t capacity;
+  size_t size;
+  struct command * commands;
+  size_t text_capacity;
+  size_t text_size;
+  char * text;
+  size_t tiles_capacity;
+  size_t tiles_size;
+  Vector2 * tiles;
+};
+
+static struct display_list lists[2];
+static int current; // lists[current] is being recorded, the other one is what the framebuffer shows
+static bool shown; // the framebuffer holds the other list
+static bool unpresented; // the framebuffer changed since the last present
+static double presented_at;
+static int redrawn;
+
+// dirty cells of the tiles mode, and the rects they merge into
+enum { CELL = 16 };
+static bool * dirty;
+static int cols, rows;
+
+// gpu tile grids are written in this mesh and drawn with the default material, 4 vertices and 2 triangles per tile
+static Mesh tile_mesh;
+static Material tile_material;
+static int tile_mesh_capacity; // tiles
+
+// vertices, texcoords and indices, in ram and on the gpu
+static long long tile_mesh_bytes(int tiles) {
+  return tiles * 2 * (long long)(4 * 5 * sizeof(float) + 6 * sizeof(unsigned short));
+}
+
+void render_init(int w, int h, bool _soft, enum render_redraw _redraw) {
+  W = w;
+  H = h;
+  soft = _soft;
+  redraw = _redraw;
+  cols = (W + CELL - 1) / CELL;
+  rows = (H + CELL - 1) / CELL;
+  dirty = mem_calloc(MEM_RENDER, cols * rows, sizeof(bool));
+  if(soft) {
+    pixels = mem_calloc(MEM_RENDER, W * H, sizeof(Color));
+    dict_init(&images, sizeof(Image), false, false);
+  } else {
+    framebuffer = LoadRenderTexture(W, H);
+    mem_add(MEM_RENDER, W * H * 8); // rgba color and 24/8 depth stencil attachments
+  }
+}
+
+void render_close(void) {
+  for(int i = 0; i < 2; i++) {
+    mem_free(lists[i].commands);
+    mem_free(lists[i].text);
+    mem_free(lists[i].tiles);
+  }
+  if(tile_mesh_capacity) {
+    UnloadMesh(tile_mesh);
+    MemFree(tile_material.maps); // not UnloadMaterial(), which would unload the last texture drawn
+    mem_add(MEM_RENDER, -tile_mesh_bytes(tile_mesh_capacity));
+    tile_mesh_capacity = 0;
+  }
+  mem_free(dirty);
+  if(soft) {
+    for(size_t i = 0; i < images.size; i++) UnloadImage(*(Image *)dict_get_by_index(&images, i));
+    dict_free(&images);
+    mem_free(pixels);
+  } else {
+    UnloadRenderTexture(framebuffer);
+    mem_add(MEM_RENDER, -W * H * 8);
+  }
+}
+
+bool render_is_soft(void) {
+  return soft;
+}
+
+// keep the pixels in memory, and hand out a texture that only carries an id and dimensions
+static Texture2D soft_texture(Image image) {
+  ImageFormat(&image, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+  Texture2D texture = {next_id++, image.width, image.height, 1, image.format};
+  dict_set(&images, texture.id, &image);
+  return texture;
+}
+
+static void soft_unload(unsigned int id) {
+  Image * image = dict_get(&images, id);
+  if(image) { UnloadImage(*image); image->data = NULL; }
+}
+
+// estimates, whether the pixels are on the gpu or in a soft image
+static long long texture_bytes(Texture2D texture) {
+  return GetPixelDataSize(texture.width, texture.height, texture.format);
+}
+
+// glyph images and rects stay in ram next to the atlas
+static long long font_bytes(Font font) {
+  long long bytes = texture_bytes(font.texture) + font.glyphCount * (sizeof(GlyphInfo) + sizeof(Rectangle));
+  for(int i = 0; i < font.glyphCount; i++) bytes += GetPixelDataSize(font.glyphs[i].image.width, font.glyphs[i].image.height, font.glyphs[i].image.format);
+  return bytes;
+}
+
+// from the mounted pack when it has the file
+static Image load_image(const char * filename) {
+  size_t size;
+  const void * data = pack_get(filename, &size);
+  Image image = data? LoadImageFromMemory(GetFileExtension(filename), data, size) : LoadImage(filename);
+  if(!image.data) { printf("LoadImage(%s) failed.\n", filename); exit(EXIT_FAILURE); }
+  return image;
+}
+
+Texture2D render_load_texture(const char * filename) {
+  Texture2D texture;
+  Image image = load_image(filename);
+  if(!soft) {
+    texture = LoadTextureFromImage(image);
+    UnloadImage(image);
+  } else {
+    texture = soft_texture(image);
+  }
+  mem_add(MEM_TEXTURE, texture_bytes(texture));
+  return texture;
+}
+
+void render_unload_texture(Texture2D texture) {
+  shown = false; // the id could be handed out again, so a diff against the last frame can't be trusted
+  mem_add(MEM_TEXTURE, -texture_bytes(texture));
+  if(!soft) UnloadTexture(texture);
+  else soft_unload(texture.id);
+}
+
+Font render_load_font(const char * filename) {
+  // same size and glyphs as LoadFont() picks for a ttf
+  const int size = 32, count = 95, padding = 4;
+  size_t packed_bytes;
+  const unsigned char * packed = pack_get(filename, &packed_bytes);
+  if(!soft) {
+    Font font = packed? LoadFontFromMemory(GetFileExtension(filename), packed, packed_bytes, size, NULL, count) : LoadFont(filename);
+    mem_add(MEM_TEXTURE, font_bytes(font));
+    return font;
+  }
+  // same steps as LoadFont() does for a ttf, minus the upload of the atlas
+  unsigned int bytes = packed_bytes;
+  unsigned char * data = packed? NULL : LoadFileData(filename, &bytes); if(!packed && !data) { printf("LoadFileData(%s) failed.\n", filename); exit(EXIT_FAILURE); }
+  Font font = {size, count, padding};
+  font.glyphs = LoadFontData(packed? packed : data, bytes, size, NULL, count, FONT_DEFAULT);
+  if(data) UnloadFileData(data);
+  if(!font.glyphs) { printf("LoadFontData(%s) failed.\n", filename); exit(EXIT_FAILURE); }
+  font.texture = soft_texture(GenImageFontAtlas(font.glyphs, &font.recs, count, size, padding, 0));
+  mem_add(MEM_TEXTURE, font_bytes(font));
+  return font;
+}
+
+void render_unload_font(Font font) {
+  shown = false;
+  mem_add(MEM_TEXTURE, -font_bytes(font));
+  if(!soft) { UnloadFont(font); return; }
+  soft_unload(font.texture.id);
+  UnloadFontData(font.glyphs, font.glyphCount);
+  MemFree(font.recs);
+}
+
+static void push(struct command command) {
+  struct display_list * list = &lists[current];
+  if(list->size == list->capacity) {
+    list->capacity = list->capacity? list->capacity * 2 : 256;
+    list->commands = mem_realloc(MEM_RENDER, list->commands, list->capacity, sizeof(struct command));
+    if(!list->commands) { printf("out of mem\n"); exit(EXIT_FAILURE); }
+  }
+  list->commands[list->size++] = command;
+}
+
+static size_t push_text(const char * text) {
+  struct display_list * list = &lists[current];
+  size_t length = strlen(text) + 1;
+  if(list->text_size + length > list->text_capacity) {
+    while(list->text_size + length > list->text_capacity) list->text_capacity = list->text_capacity? list->text_capacity * 2 : 1024;
+    list->text = mem_realloc(MEM_RENDER, list->text, list->text_capacity, 1);
+    if(!list->text) { printf("out of mem\n"); exit(EXIT_FAILURE); }
+  }
+  memcpy(list->text + list->text_size, text, length);
+  list->text_size += length;
+  return list->text_size - length;
+}
+
+static size_t push_tiles(const Vector2 * sources, size_t count) {
+  struct display_list * list = &lists[current];
+  if(list->tiles_size + count > list->tiles_capacity) {
+    while(list->tiles_size + count > list->tiles_capacity) list->tiles_capacity = list->tiles_capacity? list->tiles_capacity * 2 : 1024;
+    list->tiles = mem_realloc(MEM_RENDER, list->tiles, list->tiles_capacity, sizeof(Vector2));
+    if(!list->tiles) { printf("out of mem\n"); exit(EXIT_FAILURE); }
+  }
+  memcpy(list->tiles + list->tiles_size, sources, sizeof(Vector2) * count);
+  list->tiles_size += count;
+  return list->tiles_size - count;
+}
+
+void render_begin(void) {
+  lists[current].size = 0;
+  lists[current].text_size = 0;
+  lists[current].tiles_size = 0;
+}
+
+void render_clear(Color color) {
+  push((struct command){.type = CMD_CLEAR, .color = color});
+}
+
+void render_texture(Texture2D texture, Rectangle source, Rectangle dest, Color tint) {
+  push((struct command){.type = CMD_TEXTURE, .color = tint, .texture = texture, .source = source, .dest = dest});
+}
+
+void render_texture_at(Texture2D texture, int x, int y, Color tint) {
+  render_texture(texture, (Rectangle){0, 0, texture.width, texture.height}, (Rectangle){x, y, texture.width, texture.height}, tint);
+}
+
+void render_rectangle(int x, int y, int w, int h, Color color) {
+  push((struct command){.type = CMD_RECTANGLE, .color = color, .dest = {x, y, w, h}});
+}
+
+void render_text(Font font, const char * text, Vector2 position, float font_size, float spacing, Color tint) {
+  push((struct command){.type = CMD_TEXT, .color = tint, .dest = {position.x, position.y}, .font = font, .font_size = font_size, .spacing = spacing, .text = push_text(text)});
+}
+
+void render_tiles(Texture2D texture, const Vector2 * sources, int columns, int rows, int tile_size, Vector2 position) {
+  push((struct command){.type = CMD_TILES, .color = WHITE, .texture = texture, .source = {0, 0, tile_size, tile_size}, .dest = {position.x, position.y, columns * tile_size, rows * tile_size}, .tiles = push_tiles(sources, columns * rows), .columns = columns, .rows = rows});
+}
+
+// soft rasterizer, within the clip rect
+
+static int clip_x0, clip_y0, clip_x1, clip_y1;
+
+// glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA), which is raylib's default blend mode
+static inline void blend(Color * dst, Color src) {
+  int a = src.a, ia = 255 - src.a;
+  dst->r = (src.r * a + dst->r * ia) / 255;
+  dst->g = (src.g * a + dst->g * ia) / 255;
+  dst->b = (src.b * a + dst->b * ia) / 255;
+  dst->a = (src.a * a + dst->a * ia) / 255;
+}
+
+static void soft_clear(Color color) {
+  for(int y = clip_y0; y < clip_y1; y++) {
+    for(int x = clip_x0; x < clip_x1; x++) pixels[y * W + x] = color;
+  }
+}
+
+static void soft_texture_draw(Texture2D texture, Rectangle source, Rectangle dest, Color tint) {
+  Image * image = dict_get(&images, texture.id);
+  if(!image || !image->data || dest.width <= 0 || dest.height <= 0) return;
+  bool flip_x = source.width < 0, flip_y = source.height < 0;
+  if(flip_x) source.width = -source.width;
+  if(flip_y) source.height = -source.height;
+  // pixels whose center falls inside dest, sampled nearest
+  int x0 = fmax(clip_x0, ceil(dest.x - .5)), x1 = fmin(clip_x1, ceil(dest.x + dest.width - .5));
+  int y0 = fmax(clip_y0, ceil(dest.y - .5)), y1 = fmin(clip_y1, ceil(dest.y + dest.height - .5));
+  double sx = source.width / dest.width, sy = source.height / dest.height;
+  const Color * src = image->data;
+  for(int y = y0; y < y1; y++) {
+    double v = (y + .5 - dest.y) * sy;
+    int ty = (int)(source.y + (flip_y? source.height - v : v));
+    if(ty < 0 || ty >= image->height) continue;
+    Color * dst = &pixels[y * W];
+    for(int x = x0; x < x1; x++) {
+      double u = (x + .5 - dest.x) * sx;
+      int tx = (int)(source.x + (flip_x? source.width - u : u));
+      if(tx < 0 || tx >= image->width) continue;
+      Color c = src[ty * image->width + tx];
+      if(c.a == 0) continue;
+      c.r = c.r * tint.r / 255; c.g = c.g * tint.g / 255; c.b = c.b * tint.b / 255; c.a = c.a * tint.a / 255;
+      blend(&dst[x], c);
+    }
+  }
+}
+
+static void soft_rectangle(Rectangle r, Color color) {
+  int x0 = fmax(clip_x0, r.x), x1 = fmin(clip_x1, r.x + r.width);
+  int y0 = fmax(clip_y0, r.y), y1 = fmin(clip_y1, r.y + r.height);
+  for(int j = y0; j < y1; j++) {
+    for(int i = x0; i < x1; i++) blend(&pixels[j * W + i], color);
+  }
+}
+
+static void soft_text(Font font, const char * text, Vector2 position, float font_size, float spacing, Color tint) {
+  // same layout as DrawTextEx(), one glyph blit per character (game text is ascii)
+  double scale = font_size / font.baseSize;
+  double pad = font.glyphPadding;
+  double ox = 0, oy = 0;
+  for(const char * p = text; *p; p++) {
+    if(*p == '\n') { ox = 0; oy += font_size; continue; }
+    int i = GetGlyphIndex(font, *p);
+    Rectangle rec = font.recs[i];
+    if(*p != ' ' && *p != '\t') {
+      Rectangle source = {rec.x - pad, rec.y - pad, rec.width + 2 * pad, rec.height + 2 * pad};
+      Rectangle dest = {position.x + ox + (font.glyphs[i].offsetX - pad) * scale, position.y + oy + (font.glyphs[i].offsetY - pad) * scale, source.width * scale, source.height * scale};
+      soft_texture_draw(font.texture, source, dest, tint);
+    }
+    if(font.glyphs[i].advanceX == 0) ox += rec.width * scale + spacing;
+    else ox += font.glyphs[i].advanceX * scale + spacing;
+  }
+}
+
+static void soft_tiles(Texture2D texture, const Vector2 * sources, int columns, int rows, Rectangle tile, Vector2 position) {
+  for(int row = 0; row < rows; row++) {
+    float y = position.y + row * tile.height;
+    if(y >= clip_y1 || y + tile.height <= clip_y0) continue;
+    for(int col = 0; col < columns; col++) {
+      Vector2 source = sources[row * columns + col];
+      float x = position.x + col * tile.width;
+      if(source.x < 0 || x >= clip_x1 || x + tile.width <= clip_x0) continue;
+      soft_texture_draw(texture, (Rectangle){source.x, source.y, tile.width, tile.height}, (Rectangle){x, y, tile.width, tile.height}, WHITE);
+    }
+  }
+}
+
+// the whole grid in the reusable mesh, then one draw call
+static void gpu_tiles(Texture2D texture, const Vector2 * sources, int columns, int rows, Rectangle tile, Vector2 position) {
+  int count = columns * rows;
+  if(4 * count > 65536) { printf("render_tiles() grid over the 16 bit indices.\n"); exit(EXIT_FAILURE); }
+  if(count > tile_mesh_capacity) {
+    // grow, the index pattern never changes so it's only written here
+    if(tile_mesh_capacity) {
+      UnloadMesh(tile_mesh);
+      mem_add(MEM_RENDER, -tile_mesh_bytes(tile_mesh_capacity));
+    } else {
+      tile_material = LoadMaterialDefault();
+    }
+    tile_mesh_capacity = count;
+    tile_mesh = (Mesh){0};
+    tile_mesh.vertexCount = 4 * count;
+    tile_mesh.triangleCount = 2 * count;
+    tile_mesh.vertices = MemAlloc(sizeof(float) * 3 * 4 * count);
+    tile_mesh.texcoords = MemAlloc(sizeof(float) * 2 * 4 * count);
+    tile_mesh.indices = MemAlloc(sizeof(unsigned short) * 6 * count);
+    for(int i = 0; i < count; i++) {
+      // same winding as raylib's own quads: top left, bottom left, bottom right, top right
+      unsigned short * p = &tile_mesh.indices[6 * i];
+      p[0] = 4 * i; p[1] = 4 * i + 1; p[2] = 4 * i + 2;
+      p[3] = 4 * i; p[4] = 4 * i + 2; p[5] = 4 * i + 3;
+    }
+    UploadMesh(&tile_mesh, true);
+    mem_add(MEM_RENDER, tile_mesh_bytes(tile_mesh_capacity));
+  }
+  // empty cells are skipped, so the drawn tiles are packed at the front
+  float * v = tile_mesh.vertices;
+  float * uv = tile_mesh.texcoords;
+  const float iw = 1.0f / texture.width, ih = 1.0f / texture.height;
+  const float du = tile.width * iw, dv = tile.height * ih;
+  int n = 0;
+  for(int row = 0; row < rows; row++) {
+    float y0 = position.y + row * tile.height, y1 = y0 + tile.height;
+    for(int col = 0; col < columns; col++) {
+      Vector2 source = sources[row * columns + col];
+      if(source.x < 0) continue;
+      float x0 = position.x + col * tile.width, x1 = x0 + tile.width;
+      float u0 = source.x * iw, v0 = source.y * ih, u1 = u0 + du, v1 = v0 + dv;
+      float * p = &v[12 * n];
+      p[0] = x0; p[1] = y0; p[2] = 0;
+      p[3] = x0; p[4] = y1; p[5] = 0;
+      p[6] = x1; p[7] = y1; p[8] = 0;
+      p[9] = x1; p[10] = y0; p[11] = 0;
+      float * q = &uv[8 * n];
+      q[0] = u0; q[1] = v0;
+      q[2] = u0; q[3] = v1;
+      q[4] = u1; q[5] = v1;
+      q[6] = u1; q[7] = v0;
+      n++;
+    }
+  }
+  if(n == 0) return;
+  UpdateMeshBuffer(tile_mesh, 0, v, sizeof(float) * 12 * n, 0);
+  UpdateMeshBuffer(tile_mesh, 1, uv, sizeof(float) * 8 * n, 0);
+  // draws recorded in raylib's batch so far go first
+  rlDrawRenderBatchActive();
+  tile_material.maps[MATERIAL_MAP_DIFFUSE].texture = texture;
+  Mesh drawn = tile_mesh;
+  drawn.vertexCount = 4 * n;
+  drawn.triangleCount = 2 * n;
+  DrawMesh(drawn, tile_material, (Matrix){1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1});
+}
+
+static void execute(const struct display_list * list, const struct command * c) {
+  const char * text = list->text + c->text;
+  Vector2 position = {c->dest.x, c->dest.y};
+  if(soft) {
+    switch(c->type) {
+      case CMD_CLEAR: soft_clear(c->color); break;
+      case CMD_TEXTURE: soft_texture_draw(c->texture, c->source, c->dest, c->color); break;
+      case CMD_RECTANGLE: soft_rectangle(c->dest, c->color); break;
+      case CMD_TEXT: soft_text(c->font, text, position, c->font_size, c->spacing, c->color); break;
+      case CMD_TILES: soft_tiles(c->texture, list->tiles + c->tiles, c->columns, c->rows, c->source, position); break;
+    }
+  } else {
+    switch(c->type) {
+      case CMD_CLEAR: ClearBackground(c->color); break;
+      case CMD_TEXTURE: DrawTexturePro(c->texture, c->source, c->dest, (Vector2){0,0}, 0, c->color); break;
+      case CMD_RECTANGLE: DrawRectangle(c->dest.x, c->dest.y, c->dest.width, c->dest.height, c->color); break;
+      case CMD_TEXT: DrawTextEx(c->font, text, position, c->font_size, c->spacing, c->color); break;
+      case CMD_TILES: gpu_tiles(c->texture, list->tiles + c->tiles, c->columns, c->rows, c->source, position); break;
+    }
+  }
+}
+
+static bool color_equals(Color a, Color b) {
+  return a.r == b.r && a.g == b.g && a.b == b.b && a.a == b.a;
+}
+
+static bool rect_equals(Rectangle a, Rectangle b) {
+  return a.x == b.x && a.y == b.y && a.width == b.width && a.height == b.height;
+}
+
+static bool command_equals(const struct display_list * a, const struct command * p, const struct display_list * b, const struct command * q) {
+  if(p->type != q->type || !color_equals(p->color, q->color)) return false;
+  switch(p->type) {
+    case CMD_CLEAR: return true;
+    case CMD_TEXTURE: return p->texture.id == q->texture.id && rect_equals(p->source, q->source) && rect_equals(p->dest, q->dest);
+    case CMD_RECTANGLE: return rect_equals(p->dest, q->dest);
+    case CMD_TEXT: return p->font.texture.id == q->font.texture.id && p->font_size == q->font_size && p->spacing == q->spacing && p->dest.x == q->dest.x && p->dest.y == q->dest.y && strcmp(a->text + p->text, b->text + q->text) == 0;
+    case CMD_TILES: return p->texture.id == q->texture.id && rect_equals(p->source, q->source) && rect_equals(p->dest, q->dest) && p->columns == q->columns && p->rows == q->rows && memcmp(a->tiles + p->tiles, b->tiles + q->tiles, sizeof(Vector2) * p->columns * p->rows) == 0;
+  }
+  return false;
+}
+
+// same texture and grid, only some tiles differ
+static bool same_grid(const struct command * p, const struct command * q) {
+  return p->type == CMD_TILES && q->type == CMD_TILES && p->texture.id == q->texture.id && rect_equals(p->source, q->source) && rect_equals(p->dest, q->dest) && p->columns == q->columns && p->rows == q->rows;
+}
+
+// pixels a command can touch
+static Rectangle bounds(const struct display_list * list, const struct command * c) {
+  switch(c->type) {
+    case CMD_CLEAR: return (Rectangle){0, 0, W, H};
+    case CMD_TEXTURE:
+    case CMD_RECTANGLE:
+    case CMD_TILES: return c->dest;
+    case CMD_TEXT: {
+      Vector2 size = MeasureTextEx(c->font, list->text + c->text, c->font_size, c->spacing);
+      double pad = c->font.glyphPadding * c->font_size / c->font.baseSize;
+      return (Rectangle){c->dest.x - pad, c->dest.y - pad, size.x + 2 * pad, size.y + 2 * pad};
+    }
+  }
+  return (Rectangle){0, 0, W, H};
+}
+
+static void mark(Rectangle r) {
+  // a pixel of slack for rounding
+  int c0 = fmax(0, floor((r.x - 1) / CELL)), c1 = fmin(cols - 1, floor((r.x + r.width + 1) / CELL));
+  int r0 = fmax(0, floor((r.y - 1) / CELL)), r1 = fmin(rows - 1, floor((r.y + r.height + 1) / CELL));
+  for(int row = r0; row <= r1; row++) {
+    for(int col = c0; col <= c1; col++) dirty[row * cols + col] = true;
+  }
+}
+
+static bool overlaps(Rectangle a, Rectangle b) {
+  return a.x < b.x + b.width && b.x < a.x + a.width && a.y < b.y + b.height && b.y < a.y + a.height;
+}
+
+// replays the commands touching area, clipped to it
+static void replay_area(const struct display_list * list, Rectangle area, bool clipped) {
+  if(soft) {
+    clip_x0 = area.x; clip_y0 = area.y; clip_x1 = fmin(W, area.x + area.width); clip_y1 = fmin(H, area.y + area.height);
+  } else if(clipped) {
+    BeginScissorMode(area.x, area.y, area.width, area.height);
+  }
+  for(size_t i = 0; i < list->size; i++) {
+    const struct command * c = &list->commands[i];
+    if(!clipped || overlaps(bounds(list, c), area)) execute(list, c);
+  }
+  if(!soft && clipped) EndScissorMode();
+}
+
+bool render_end(void) {
+  const struct display_list * now = &lists[current];
+  const struct display_list * before = &lists[1 - current];
+  bool changed = true;
+  if(shown && redraw != REDRAW_ALL) {
+    // a pixel only needs redrawing if a command touching it differs, so a command-by-command comparison is enough
+    if(redraw == REDRAW_TILES) memset(dirty, 0, sizeof(bool) * cols * rows);
+    changed = false;
+    size_t n = (now->size > before->size)? now->size : before->size;
+    for(size_t i = 0; i < n; i++) {
+      bool same = i < now->size && i < before->size && command_equals(now, &now->commands[i], before, &before->commands[i]);
+      if(same) continue;
+      changed = true;
+      if(redraw != REDRAW_TILES) break;
+      if(i < now->size && i < before->size && same_grid(&now->commands[i], &before->commands[i])) {
+        // only the tiles that differ, e.g. animated water over a still map
+        const struct command * c = &now->commands[i];
+        const Vector2 * p = now->tiles + c->tiles, * q = before->tiles + before->commands[i].tiles;
+        for(int j = 0; j < c->columns * c->rows; j++) {
+          if(p[j].x == q[j].x && p[j].y == q[j].y) continue;
+          mark((Rectangle){c->dest.x + (j % c->columns) * c->source.width, c->dest.y + (j / c->columns) * c->source.height, c->source.width, c->source.height});
+        }
+        continue;
+      }
+      if(i < now->size) mark(bounds(now, &now->commands[i]));
+      if(i < before->size) mark(bounds(before, &before->commands[i]));
+    }
+  }
+  if(changed) {
+    if(!soft) BeginTextureMode(framebuffer);
+    if(!shown || redraw != REDRAW_TILES) {
+      replay_area(now, (Rectangle){0, 0, W, H}, false);
+    } else {
+      // runs of dirty cells in a row, extended down while the next rows have the same run
+      for(int row = 0; row < rows; row++) {
+        for(int col = 0; col < cols; col++) {
+          if(!dirty[row * cols + col]) continue;
+          int end = col;
+          while(end + 1 < cols && dirty[row * cols + end + 1]) end++;
+          int bottom = row;
+          bool same = true;
+          while(same && bottom + 1 < rows) {
+            for(int c = col; c <= end && same; c++) same = dirty[(bottom + 1) * cols + c];
+            if(same) bottom++;
+          }
+          for(int r = row; r <= bottom; r++) {
+            for(int c = col; c <= end; c++) dirty[r * cols + c] = false;
+          }
+          replay_area(now, (Rectangle){col * CELL, row * CELL, (end - col + 1) * CELL, (bottom - row + 1) * CELL}, true);
+        }
+      }
+    }
+    if(!soft) EndTextureMode();
+    redrawn++;
+    unpresented = true;
+  }
+  shown = true;
+  current = 1 - current;
+  return changed;
+}
+
+int render_redrawn(void) {
+  return redrawn;
+}
+
+void render_present(double idle_frame_time) {
+  if(soft) return;
+  double t = now();
+  if(idle_frame_time > 0 && !unpresented && !IsWindowResized()) {
+    // the screen already shows this, keep input alive and wait out the frame like EndDrawing() would
+    PollInputEvents();
+    double wait = presented_at + idle_frame_time - now();
+    if(wait > 0) {
+      struct timespec ts = {(time_t)wait, (long)((wait - (time_t)wait) * 1e9)};
+      nanosleep(&ts, NULL);
+    }
+    presented_at = now();
+    return;
+  }
+  BeginDrawing();
+  double scale, x, y; center_fit(GetScreenWidth(), GetScreenHeight(), W, H, &scale, &x, &y);
+  if(x || y) { ClearBackground(BLACK); }
+  DrawTexturePro(framebuffer.texture, (Rectangle){0,0,W,-H}, (Rectangle){x,y,W*scale,H*scale}, (Vector2){0,0}, 0, WHITE);
+  EndDrawing();
+  unpresented = false;
+  presented_at = t;
+}
+
+bool render_export(const char * filename) {
+  if(soft) return ExportImage((Image){pixels, W, H, 1, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8}, filename);
+  Image image = LoadImageFromTexture(framebuffer.texture);
+  ImageFlipVertical(&image);
+  bool ok = ExportImage(image, filename);
+  UnloadImage(image);
+  return ok;
+}
+
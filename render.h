@@ -0,0 +1,39 @@
+#pragma once
+// Copyright 2023 David Lareau. This program is free software under the terms of the Zero Clause BSD.
+#include <stdbool.h>
+#include <raylib.h>
+
+// the handful of draw primitives the game uses, onto a W x H framebuffer
+// - gpu: raylib render texture, scaled to the window on present
+// - soft: cpu rasterizer in memory, for machines without gpu or display (no window needed)
+// textures and fonts come from the mounted pack when it has them (see pack.h)
+// draw calls between render_begin() and render_end() are recorded, and compared with the previous frame before any pixel is touched
+// - REDRAW_ALL: always draw everything
+// - REDRAW_CHANGED: skip the frame when nothing differs (e.g. a message box waiting for a key)
+// - REDRAW_TILES: only redraw the 16x16 cells touched by the commands that differ, replaying what overlaps them clipped
+
+enum render_redraw { REDRAW_ALL, REDRAW_CHANGED, REDRAW_TILES };
+
+void render_init(int w, int h, bool soft, enum render_redraw redraw);
+void render_close(void);
+bool render_is_soft(void);
+
+Texture2D render_load_texture(const char * filename);
+void render_unload_texture(Texture2D texture);
+Font render_load_font(const char * filename);
+void render_unload_font(Font font);
+
+void render_begin(void);
+bool render_end(void); // draws what changed, returns false if the framebuffer was left untouched
+int render_redrawn(void); // frames where render_end() touched the framebuffer
+void render_present(double idle_frame_time); // gpu only, fits the framebuffer in the window; when idle_frame_time > 0 and nothing changed since the last present, only polls input and sleeps out the frame
+bool render_export(const char * filename); // writes the framebuffer as png
+
+void render_clear(Color color);
+void render_texture(Texture2D texture, Rectangle source, Rectangle dest, Color tint); // negative source width/height mirrors
+void render_texture_at(Texture2D texture, int x, int y, Color tint);
+void render_rectangle(int x, int y, int w, int h, Color color);
+void render_text(Font font, const char * text, Vector2 position, float font_size, float spacing, Color tint);
+// a columns x rows grid of tile_size tiles from one texture, as a single mesh on the gpu
+// sources[i] is the top left of cell i (row major) in the texture, with a negative x for an empty cell
+void render_tiles(Texture2D texture, const Vector2 * sources, int columns, int rows, int tile_size, Vector2 position);
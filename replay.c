@@ -0,0 +1,78 @@
+// Copyright 2023 David Lareau. This program is free software under the terms of the Zero Clause BSD.
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include "replay.h"
+#include "mem.h"
+
+static const char * KEY_NAMES = "LRAUD";
+
+void replay_init(struct replay * self) {
+  self->capacity = 16;
+  self->size = 0;
+  self->frames = mem_realloc(MEM_REPLAY, NULL, self->capacity, sizeof(uint64_t));
+  self->keys = mem_realloc(MEM_REPLAY, NULL, self->capacity, sizeof(uint8_t));
+  self->cursor = 0;
+}
+
+void replay_free(struct replay * self) {
+  mem_free(self->frames);
+  mem_free(self->keys);
+}
+
+void replay_push(struct replay * self, uint64_t frame, uint8_t keys) {
+  if(self->size > 0 && self->keys[self->size - 1] == keys) return;
+  if(self->size == self->capacity) {
+    self->capacity *= 2;
+    self->frames = mem_realloc(MEM_REPLAY, self->frames, self->capacity, sizeof(uint64_t));
+    self->keys = mem_realloc(MEM_REPLAY, self->keys, self->capacity, sizeof(uint8_t));
+    if(!self->frames || !self->keys) { printf("out of mem\n"); exit(EXIT_FAILURE); };
+  }
+  self->frames[self->size] = frame;
+  self->keys[self->size] = keys;
+  self->size++;
+}
+
+bool replay_load(struct replay * self, const char * filename) {
+  FILE * f = fopen(filename, "r"); if(!f) return false;
+  char line[256];
+  int line_number = 0;
+  while(fgets(line, sizeof(line), f)) {
+    line_number++;
+    if(line[0] == '#' || line[0] == '\n') continue;
+    uint64_t frame;
+    char names[16];
+    if(sscanf(line, "%" SCNu64 " %15s", &frame, names) != 2 || (self->size > 0 && frame <= self->frames[self->size - 1])) { printf("%s:%d: bad replay line\n", filename, line_number); fclose(f); return false; }
+    uint8_t keys = 0;
+    for(char * c = names; *c && *c != '-'; c++) {
+      const char * k = strchr(KEY_NAMES, *c);
+      if(!k) { printf("%s:%d: unknown key %c\n", filename, line_number, *c); fclose(f); return false; }
+      keys |= 1 << (k - KEY_NAMES);
+    }
+    replay_push(self, frame, keys);
+  }
+  fclose(f);
+  return true;
+}
+
+bool replay_save(struct replay * self, const char * filename) {
+  FILE * f = fopen(filename, "w"); if(!f) return false;
+  fprintf(f, "# frame keys(%s)\n", KEY_NAMES);
+  for(size_t i = 0; i < self->size; i++) {
+    char names[8] = "-";
+    for(int k = 0, n = 0; KEY_NAMES[k]; k++) if(self->keys[i] & (1 << k)) { names[n++] = KEY_NAMES[k]; names[n] = '\0'; }
+    fprintf(f, "%" PRIu64 " %s\n", self->frames[i], names);
+  }
+  return fclose(f) == 0;
+}
+
+uint8_t replay_keys(struct replay * self, uint64_t frame) {
+  if(self->cursor >= self->size || self->frames[self->cursor] > frame) self->cursor = 0;
+  while(self->cursor + 1 < self->size && self->frames[self->cursor + 1] <= frame) self->cursor++;
+  if(self->cursor >= self->size || self->frames[self->cursor] > frame) return 0;
+  return self->keys[self->cursor];
+}
+
+uint64_t replay_length(struct replay * self) {
+  return self->size? self->frames[self->size - 1] + 1 : 0;
+}
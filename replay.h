@@ -0,0 +1,24 @@
+#pragma once
+// Copyright 2023 David Lareau. This program is free software under the terms of the Zero Clause BSD.
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// input script: which virtual keys are held, frame by frame
+// text file, one "frame keys" line per change, keys among LRAUD (enum vk order) or - for none, # comments
+
+struct replay {
+  size_t capacity;
+  size_t size;
+  uint64_t * frames; // increasing
+  uint8_t * keys; // bit per enum vk, held from that frame until the next entry
+  size_t cursor;
+};
+
+void replay_init(struct replay * self);
+void replay_free(struct replay * self);
+bool replay_load(struct replay * self, const char * filename);
+bool replay_save(struct replay * self, const char * filename);
+void replay_push(struct replay * self, uint64_t frame, uint8_t keys); // frames must increase, only changes are stored
+uint8_t replay_keys(struct replay * self, uint64_t frame); // fastest when queried with increasing frames
+uint64_t replay_length(struct replay * self); // frame of the last entry + 1
@@ -0,0 +1,126 @@
+// Copyright 2023 David Lareau. This program is free software under the terms of the Zero Clause BSD.
+#include <string.h>
+#include "sound.h"
+#include "mem.h"
+#include "pack.h"
+
+size_t sound_stream_bytes(Music music) {
+  // two sub-buffers of a 30th of a second, decoder state not counted
+  const AudioStream * s = &music.stream;
+  return 2 * (s->sampleRate / 30) * s->channels * (s->sampleSize / 8);
+}
+
+Music sound_load_music(const char * filename) {
+  size_t size;
+  const void * data = pack_get(filename, &size);
+  Music music = data? LoadMusicStreamFromMemory(GetFileExtension(filename), data, size) : LoadMusicStream(filename);
+  if(!music.stream.buffer) { printf("LoadMusicStream(%s) failed.\n", filename); exit(EXIT_FAILURE); }
+  return music;
+}
+
+static Sound load_sound(const char * filename) {
+  size_t size;
+  const void * data = pack_get(filename, &size);
+  if(!data) return LoadSound(filename);
+  Wave wave = LoadWaveFromMemory(GetFileExtension(filename), data, size);
+  Sound sound = LoadSoundFromWave(wave);
+  UnloadWave(wave);
+  return sound;
+}
+
+void sound_bank_init(struct sound_bank * self, const char ** filenames, int size, size_t stream_threshold, size_t budget) {
+  self->size = size;
+  self->clips = mem_calloc(MEM_AUDIO, size, sizeof(struct sound_clip));
+  self->stream_threshold = stream_threshold;
+  self->budget = budget;
+  self->resident = 0;
+  self->peak = 0;
+  self->clock = 0;
+  for(int i = 0; i < size; i++) {
+    struct sound_clip * clip = &self->clips[i];
+    clip->filename = filenames[i];
+    if(!clip->filename) continue;
+    // only the file size is looked at up front, to decide how it will be played
+    size_t packed_size;
+    clip->file_size = pack_get(clip->filename, &packed_size)? (int)packed_size : GetFileLength(clip->filename);
+    if(clip->file_size <= 0) { printf("GetFileLength(%s) failed.\n", clip->filename); exit(EXIT_FAILURE); }
+    clip->streamed = (size_t)clip->file_size > stream_threshold;
+  }
+}
+
+static void unload(struct sound_bank * self, struct sound_clip * clip) {
+  if(!clip->loaded) return;
+  if(clip->streamed) UnloadMusicStream(clip->music);
+  else UnloadSound(clip->sound);
+  clip->loaded = false;
+  self->resident -= clip->bytes;
+  mem_add(MEM_AUDIO, -(long long)clip->bytes);
+  clip->bytes = 0;
+}
+
+void sound_bank_free(struct sound_bank * self) {
+  for(int i = 0; i < self->size; i++) unload(self, &self->clips[i]);
+  mem_free(self->clips);
+}
+
+// least recently used first, skipping keep and anything still playing
+static void evict(struct sound_bank * self, const struct sound_clip * keep) {
+  while(self->resident > self->budget) {
+    struct sound_clip * victim = NULL;
+    for(int i = 0; i < self->size; i++) {
+      struct sound_clip * clip = &self->clips[i];
+      if(clip == keep || !clip->loaded || clip->streamed || IsSoundPlaying(clip->sound)) continue;
+      if(!victim || clip->last_used < victim->last_used) victim = clip;
+    }
+    if(!victim) return;
+    unload(self, victim);
+  }
+}
+
+void sound_bank_play(struct sound_bank * self, int id) {
+  if(id <= 0 || id >= self->size || !IsAudioDeviceReady()) return;
+  struct sound_clip * clip = &self->clips[id];
+  clip->last_used = ++self->clock;
+  if(!clip->loaded) {
+    if(clip->streamed) {
+      clip->music = sound_load_music(clip->filename);
+      clip->music.looping = false;
+      clip->bytes = sound_stream_bytes(clip->music);
+    } else {
+      clip->sound = load_sound(clip->filename); if(!clip->sound.stream.buffer) { printf("LoadSound(%s) failed.\n", clip->filename); exit(EXIT_FAILURE); }
+      const AudioStream * s = &clip->sound.stream;
+      clip->bytes = (size_t)clip->sound.frameCount * s->channels * (s->sampleSize / 8);
+    }
+    clip->loaded = true;
+    self->resident += clip->bytes;
+    mem_add(MEM_AUDIO, clip->bytes);
+    if(self->resident > self->peak) self->peak = self->resident;
+    evict(self, clip);
+  }
+  if(clip->streamed) {
+    StopMusicStream(clip->music); // restart if it was already playing
+    PlayMusicStream(clip->music);
+  } else {
+    PlaySound(clip->sound);
+  }
+}
+
+void sound_bank_update(struct sound_bank * self) {
+  for(int i = 0; i < self->size; i++) {
+    struct sound_clip * clip = &self->clips[i];
+    if(!clip->loaded || !clip->streamed) continue;
+    if(IsMusicStreamPlaying(clip->music)) UpdateMusicStream(clip->music);
+    else unload(self, clip);
+  }
+}
+
+void sound_bank_report(struct sound_bank * self, FILE * f) {
+  fprintf(f, "audio: %zu KB resident, %zu KB peak, %zu KB budget\n", self->resident / 1024, self->peak / 1024, self->budget / 1024);
+  for(int i = 0; i < self->size; i++) {
+    struct sound_clip * clip = &self->clips[i];
+    if(!clip->filename) continue;
+    fprintf(f, "  %-12s %4d KB file, %s, %s", clip->filename, clip->file_size / 1024, clip->streamed? "streamed" : "decoded", clip->loaded? "loaded" : "not loaded");
+    if(clip->loaded) fprintf(f, " %zu KB", clip->bytes / 1024);
+    fprintf(f, "\n");
+  }
+}
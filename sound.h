@@ -0,0 +1,43 @@
+#pragma once
+// Copyright 2023 David Lareau. This program is free software under the terms of the Zero Clause BSD.
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <raylib.h>
+
+// sound effects by id, decoded on first play instead of at startup
+// - clips whose file is above stream_threshold bytes are streamed like music while they play, then closed
+// - decoded clips are evicted least recently used first once resident bytes go over budget (never while playing)
+// - without an audio device (i.e. headless) nothing is ever loaded
+// - files come from the mounted pack when it has them (see pack.h)
+
+struct sound_clip {
+  const char * filename;
+  int file_size;
+  bool streamed;
+  bool loaded;
+  Sound sound; // when loaded and not streamed
+  Music music; // when loaded and streamed
+  size_t bytes; // resident while loaded
+  uint64_t last_used;
+};
+
+struct sound_bank {
+  int size;
+  struct sound_clip * clips;
+  size_t stream_threshold;
+  size_t budget;
+  size_t resident;
+  size_t peak;
+  uint64_t clock;
+};
+
+// filenames[0] can be NULL for a "no sound" id
+void sound_bank_init(struct sound_bank * self, const char ** filenames, int size, size_t stream_threshold, size_t budget);
+void sound_bank_free(struct sound_bank * self);
+void sound_bank_play(struct sound_bank * self, int id);
+void sound_bank_update(struct sound_bank * self); // once per frame, feeds and closes streams
+void sound_bank_report(struct sound_bank * self, FILE * f);
+size_t sound_stream_bytes(Music music); // estimated buffers of a music stream
+Music sound_load_music(const char * filename); // from the mounted pack when it has the file
@@ -0,0 +1,10 @@
+#pragma once
+// Copyright 2023 David Lareau. This program is free software under the terms of the Zero Clause BSD.
+#include <time.h>
+
+// seconds on CLOCK_MONOTONIC, the same clock as evdev timestamps (see input.h)
+static inline double now() {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec / 1e9;
+}
@@ -0,0 +1,227 @@
+// Copyright 2023 David Lareau. This program is free software under the terms of the Zero Clause BSD.
+// gcc --pedantic -Wall -Werror-implicit-function-declaration -Wno-pointer-sign -O2 -pthread -I. -o batch tools/batch.c game.c world.c collision.c data-util.c replay.c mem.c pack.c $(pkg-config --libs --cflags libxml-2.0) -lm
+
+// runs many headless game instances in parallel, each with its own input
+// - instances are spread over per thread deques, and idle threads steal from the others
+// - the world is loaded once and shared read-only
+// - prints throughput, how far the quest got, and a hash of all final states (identical for any thread count)
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "game.h"
+#include "replay.h"
+#include "pack.h"
+#include "time-util.h"
+
+struct instance {
+  const char * script; // or NULL to fuzz
+  const char * record; // or NULL, where to save the input played
+  uint64_t seed;
+  uint64_t frames;
+  // results
+  enum item held_item;
+  bool won;
+  uint64_t hash;
+};
+
+struct worker {
+  pthread_t thread;
+  pthread_mutex_t lock;
+  int * deque; // instance indices, the owner pops the back, thieves steal the front
+  int front, back;
+  struct pool * pool;
+};
+
+struct pool {
+  const struct world * world;
+  struct instance * instances;
+  int worker_count;
+  struct worker * workers;
+};
+
+static uint64_t xorshift(uint64_t * state) {
+  *state ^= *state << 13;
+  *state ^= *state >> 7;
+  *state ^= *state << 17;
+  return *state;
+}
+
+static void run(const struct world * world, struct instance * self) {
+  struct replay replay;
+  replay_init(&replay);
+  if(self->script && !replay_load(&replay, self->script)) { printf("replay_load(%s) failed.\n", self->script); exit(EXIT_FAILURE); }
+  // fuzzing holds random directions for a random number of frames, sometimes with the action key
+  uint64_t rng = self->seed * 0x9E3779B97F4A7C15 | 1;
+  uint64_t hold_until = 0;
+  uint8_t keys = 0, previous_keys = 0;
+  struct game_state state;
+  game_init(&state);
+  struct replay recorded;
+  if(self->record) replay_init(&recorded);
+  // same fixed 1/60s steps as a headless --script run of the game
+  double t0 = 0;
+  for(uint64_t frame = 0; frame < self->frames; frame++) {
+    double t = frame / 60.0;
+    previous_keys = keys;
+    if(self->script) {
+      keys = replay_keys(&replay, frame);
+    } else if(frame >= hold_until) {
+      uint64_t r = xorshift(&rng);
+      const uint8_t directions = (1 << LEFT) | (1 << RIGHT) | (1 << UP) | (1 << DOWN);
+      keys = (r & directions) | ((r >> 8) % 4 == 0) << ACTION;
+      hold_until = frame + 1 + (r >> 16) % 60;
+    }
+    if(self->record) replay_push(&recorded, frame, keys);
+    game_step(&state, world, keys, previous_keys, t - t0);
+    t0 = t;
+  }
+  if(self->record) {
+    if(!replay_save(&recorded, self->record)) { printf("replay_save(%s) failed.\n", self->record); exit(EXIT_FAILURE); }
+    replay_free(&recorded);
+  }
+  self->held_item = state.held_item;
+  self->won = state.winner_t0 != -1;
+  uint8_t blob[game_snapshot_size()];
+  game_snapshot(&state, blob);
+  self->hash = pack_hash(blob, sizeof(blob));
+  replay_free(&replay);
+}
+
+static bool take(struct worker * self, int * instance) {
+  pthread_mutex_lock(&self->lock);
+  bool ok = self->front < self->back;
+  if(ok) *instance = self->deque[--self->back];
+  pthread_mutex_unlock(&self->lock);
+  return ok;
+}
+
+static bool steal(struct worker * self, int * instance) {
+  pthread_mutex_lock(&self->lock);
+  bool ok = self->front < self->back;
+  if(ok) *instance = self->deque[self->front++];
+  pthread_mutex_unlock(&self->lock);
+  return ok;
+}
+
+// nothing is ever pushed once the threads run, so a full round of failed steals means all is done
+static void * work(void * arg) {
+  struct worker * self = arg;
+  struct pool * pool = self->pool;
+  int index = self - pool->workers;
+  int instance;
+  while(true) {
+    if(take(self, &instance)) { run(pool->world, &pool->instances[instance]); continue; }
+    bool stolen = false;
+    for(int i = 1; i < pool->worker_count && !stolen; i++) stolen = steal(&pool->workers[(index + i) % pool->worker_count], &instance);
+    if(!stolen) break;
+    run(pool->world, &pool->instances[instance]);
+  }
+  return NULL;
+}
+
+static void usage(const char * program) {
+  printf("usage: %s [--threads n] [--instances n] [--frames n] [--seed n] [--world file] [--record file] [script ...]\n", program);
+  printf("  --threads    default: one per core\n");
+  printf("  --instances  default: one per script, or 64 fuzzed instances\n");
+  printf("  --frames     per instance, default: script length, or 36000 (10 minutes) when fuzzing\n");
+  printf("  --seed       first fuzzing seed, instance i uses seed + i\n");
+  printf("  --world      a .world file to play instead of the quest, e.g. one made by zeldaish-worldgen\n");
+  printf("  --record     save the input of the first instance, e.g. to replay a fuzzed session in the game\n");
+  printf("  scripts are assigned to instances round robin, without any the input is fuzzed\n");
+  exit(EXIT_FAILURE);
+}
+
+int main(int argc, char * argv[]) {
+  int thread_count = sysconf(_SC_NPROCESSORS_ONLN);
+  int instance_count = 0;
+  uint64_t frames = 0;
+  uint64_t seed = 1;
+  const char * world_filename = NULL;
+  const char * record_filename = NULL;
+  const char ** scripts = malloc(sizeof(char *) * argc);
+  int script_count = 0;
+  for(int i = 1; i < argc; i++) {
+    if(strcmp(argv[i], "--threads") == 0 && i + 1 < argc) thread_count = strtol(argv[++i], NULL, 10);
+    else if(strcmp(argv[i], "--instances") == 0 && i + 1 < argc) instance_count = strtol(argv[++i], NULL, 10);
+    else if(strcmp(argv[i], "--frames") == 0 && i + 1 < argc) frames = strtoull(argv[++i], NULL, 10);
+    else if(strcmp(argv[i], "--seed") == 0 && i + 1 < argc) seed = strtoull(argv[++i], NULL, 10);
+    else if(strcmp(argv[i], "--world") == 0 && i + 1 < argc) world_filename = argv[++i];
+    else if(strcmp(argv[i], "--record") == 0 && i + 1 < argc) record_filename = argv[++i];
+    else if(argv[i][0] == '-') usage(argv[0]);
+    else scripts[script_count++] = argv[i];
+  }
+  if(thread_count < 1) usage(argv[0]);
+  if(instance_count <= 0) instance_count = script_count? script_count : 64;
+
+  struct world world;
+  if(world_filename) world_init_file(&world, world_filename);
+  else world_init(&world);
+  world_load_all(&world);
+
+  struct instance * instances = calloc(instance_count, sizeof(struct instance));
+  for(int i = 0; i < instance_count; i++) {
+    struct instance * instance = &instances[i];
+    instance->seed = seed + i;
+    instance->frames = frames? frames : 36000;
+    if(i == 0) instance->record = record_filename;
+    if(script_count) {
+      instance->script = scripts[i % script_count];
+      if(!frames) {
+        struct replay replay;
+        replay_init(&replay);
+        if(!replay_load(&replay, instance->script)) { printf("replay_load(%s) failed.\n", instance->script); exit(EXIT_FAILURE); }
+        instance->frames = replay_length(&replay);
+        replay_free(&replay);
+      }
+    }
+  }
+
+  // deal instances round robin, stealing evens out whatever imbalance is left
+  struct pool pool = {&world, instances, thread_count, calloc(thread_count, sizeof(struct worker))};
+  for(int i = 0; i < thread_count; i++) {
+    struct worker * worker = &pool.workers[i];
+    pthread_mutex_init(&worker->lock, NULL);
+    worker->deque = malloc(sizeof(int) * (instance_count / thread_count + 1));
+    worker->pool = &pool;
+  }
+  for(int i = 0; i < instance_count; i++) {
+    struct worker * worker = &pool.workers[i % thread_count];
+    worker->deque[worker->back++] = i;
+  }
+  double t0 = now();
+  for(int i = 0; i < thread_count; i++) {
+    if(pthread_create(&pool.workers[i].thread, NULL, work, &pool.workers[i])) { printf("pthread_create() failed.\n"); exit(EXIT_FAILURE); }
+  }
+  for(int i = 0; i < thread_count; i++) pthread_join(pool.workers[i].thread, NULL);
+  double elapsed = now() - t0;
+
+  // results in instance order, so they don't depend on scheduling
+  uint64_t total_frames = 0;
+  uint64_t hash = PACK_HASH_BASIS;
+  int won = 0;
+  int held[ITEM_COUNT] = {0};
+  for(int i = 0; i < instance_count; i++) {
+    total_frames += instances[i].frames;
+    hash = pack_hash_more(hash, &instances[i].hash, sizeof(uint64_t));
+    won += instances[i].won;
+    held[instances[i].held_item]++;
+  }
+  printf("%d instances on %d threads: %llu frames in %.3f s, %.0f frames/s\n", instance_count, thread_count, (unsigned long long)total_frames, elapsed, total_frames / elapsed);
+  printf("won: %d, holding:", won);
+  for(int i = 1; i < ITEM_COUNT; i++) printf(" %s %d", ITEM_NAMES[i], held[i]);
+  printf("\nstate hash: %016llx\n", (unsigned long long)hash);
+
+  for(int i = 0; i < thread_count; i++) {
+    pthread_mutex_destroy(&pool.workers[i].lock);
+    free(pool.workers[i].deque);
+  }
+  free(pool.workers);
+  free(instances);
+  free(scripts);
+  world_free(&world);
+  return EXIT_SUCCESS;
+}
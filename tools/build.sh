@@ -0,0 +1,54 @@
+#!/bin/sh
+# Copyright 2023 David Lareau. This program is free software under the terms of the Zero Clause BSD.
+
+# optimized builds of the game, run from the repository root (the gcc line at the top of main.c stays the quick unoptimized build)
+# tools/build.sh release  -O2, gives zeldaish-release
+# tools/build.sh lto      -O2 with link time optimization, gives zeldaish-lto
+# tools/build.sh pgo      lto, then rebuilt with the profile of an instrumented build replaying the training session, gives zeldaish-pgo
+# tools/build.sh bench    builds all three, then times the training session headless with each
+# tools/build.sh          builds all three
+# - the training session (SESSION, default train.replay) is any --record file, train.replay is the whole quest played by the route planner (./quest train.replay, see tools/quest.c)
+# - so every npc, the kaboom and the winner particles are in the profile, which a fuzzed session never gets to
+# - it's replayed headless with every frame redrawn, so the profile covers the simulation (collision, dict lookups) and the tile draw of the soft renderer
+# - code the session never reaches is still optimized as in the lto build (-fprofile-partial-training)
+# - RUNS (default 3) runs per build in the benchmark, the best sim and render times are kept
+
+set -e
+FLAGS="--pedantic -Wall -Werror-implicit-function-declaration -Wno-pointer-sign -pthread -O2"
+LIBS="$(pkg-config --libs --cflags libxml-2.0 raylib) -lm"
+SESSION=${SESSION:-train.replay}
+RUNS=${RUNS:-3}
+TRAINING="--headless --script $SESSION --redraw all"
+
+release() {
+  gcc $FLAGS -o zeldaish-release *.c $LIBS
+}
+
+lto() {
+  gcc $FLAGS -flto=auto -o zeldaish-lto *.c $LIBS
+}
+
+# profile files are named after the output, so both passes build the same name
+pgo() {
+  rm -rf pgo-profile
+  gcc $FLAGS -flto=auto -fprofile-generate -fprofile-update=atomic -fprofile-dir=pgo-profile -o zeldaish-pgo *.c $LIBS
+  ./zeldaish-pgo $TRAINING > /dev/null
+  gcc $FLAGS -flto=auto -fprofile-use -fprofile-partial-training -Wno-missing-profile -fprofile-dir=pgo-profile -o zeldaish-pgo *.c $LIBS
+}
+
+# the headless summary ends with: sim x ms/frame, render y ms/frame, overlapped z ms/frame
+bench() {
+  printf "%-8s %10s %10s\n" build "sim ms" "render ms"
+  for build in release lto pgo; do
+    for run in $(seq $RUNS); do ./zeldaish-$build $TRAINING | tail -n 1; done | sed -n 's/.*sim \([0-9.]*\) ms\/frame, render \([0-9.]*\) ms\/frame.*/\1 \2/p' | sort -n | awk -v build=$build 'NR == 1 { sim = $1; render = $2 } $2 < render { render = $2 } END { printf "%-8s %10.4f %10.4f\n", build, sim, render }'
+  done
+}
+
+case "${1:-all}" in
+  release) release ;;
+  lto) lto ;;
+  pgo) pgo ;;
+  bench) release; lto; pgo; bench ;;
+  all) release; lto; pgo ;;
+  *) echo "usage: $0 [release|lto|pgo|bench|all]"; exit 1 ;;
+esac
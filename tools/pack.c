@@ -0,0 +1,83 @@
+// Copyright 2023 David Lareau. This program is free software under the terms of the Zero Clause BSD.
+// gcc --pedantic -Wall -Werror-implicit-function-declaration -Wno-pointer-sign -O2 -I. -o zeldaish-pack tools/pack.c $(pkg-config --cflags libxml-2.0)
+
+// builds the asset pack the game mounts (see pack.h)
+// ./zeldaish-pack zeldaish.pack *.png *.ogg *.tmx *.tsx *.ttf *.world *.xml
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "pack.h"
+
+struct file {
+  const char * name;
+  uint8_t * data;
+  size_t size;
+};
+
+static uint8_t * read_file(const char * filename, size_t * size) {
+  FILE * f = fopen(filename, "rb"); if(!f) { printf("fopen(%s) failed.\n", filename); exit(EXIT_FAILURE); }
+  fseek(f, 0, SEEK_END);
+  long length = ftell(f); if(length < 0) { printf("ftell(%s) failed.\n", filename); exit(EXIT_FAILURE); }
+  fseek(f, 0, SEEK_SET);
+  uint8_t * data = malloc(length? length : 1);
+  if(fread(data, 1, length, f) != (size_t)length) { printf("fread(%s) failed.\n", filename); exit(EXIT_FAILURE); }
+  fclose(f);
+  *size = length;
+  return data;
+}
+
+static size_t align(size_t offset) {
+  return (offset + 15) & ~(size_t)15;
+}
+
+int main(int argc, char * argv[]) {
+  if(argc < 3) { printf("usage: %s pack file ...\n", argv[0]); exit(EXIT_FAILURE); }
+  int count = argc - 2;
+  struct file * files = calloc(count, sizeof(struct file));
+  for(int i = 0; i < count; i++) {
+    files[i].name = argv[i + 2];
+    files[i].data = read_file(files[i].name, &files[i].size);
+    for(int j = 0; j < i; j++) if(strcmp(files[j].name, files[i].name) == 0) { printf("%s is listed twice.\n", files[i].name); exit(EXIT_FAILURE); }
+  }
+  // table at most half full, so probes stay short
+  uint32_t slot_count = 1;
+  while(slot_count < 2 * (uint32_t)count) slot_count *= 2;
+  struct pack_entry * slots = calloc(slot_count, sizeof(struct pack_entry));
+  // names right after the table, contents after the names, each content 16 bytes aligned
+  size_t offset = sizeof(struct pack_header) + sizeof(struct pack_entry) * slot_count;
+  size_t names = offset;
+  for(int i = 0; i < count; i++) offset += strlen(files[i].name);
+  for(int i = 0; i < count; i++) {
+    size_t name_length = strlen(files[i].name);
+    uint64_t hash = pack_hash(files[i].name, name_length);
+    uint32_t slot = hash & (slot_count - 1);
+    while(slots[slot].name_length) slot = (slot + 1) & (slot_count - 1);
+    offset = align(offset);
+    slots[slot] = (struct pack_entry){hash, offset, files[i].size, pack_hash(files[i].data, files[i].size), names, name_length};
+    names += name_length;
+    offset += files[i].size;
+  }
+
+  FILE * f = fopen(argv[1], "wb"); if(!f) { printf("fopen(%s) failed.\n", argv[1]); exit(EXIT_FAILURE); }
+  struct pack_header header = {{'Z', 'P', 'A', 'K'}, PACK_VERSION, count, slot_count};
+  fwrite(&header, sizeof(header), 1, f);
+  fwrite(slots, sizeof(struct pack_entry), slot_count, f);
+  for(int i = 0; i < count; i++) fwrite(files[i].name, 1, strlen(files[i].name), f);
+  size_t total = 0;
+  for(int i = 0; i < count; i++) {
+    static const uint8_t zeros[16];
+    long position = ftell(f);
+    fwrite(zeros, 1, align(position) - position, f);
+    fwrite(files[i].data, 1, files[i].size, f);
+    total += files[i].size;
+  }
+  long size = ftell(f);
+  if(fclose(f) != 0) { printf("fclose(%s) failed.\n", argv[1]); exit(EXIT_FAILURE); }
+  printf("%s: %d files, %zu KB of content, %ld KB pack\n", argv[1], count, total / 1024, size / 1024);
+
+  for(int i = 0; i < count; i++) free(files[i].data);
+  free(files);
+  free(slots);
+  return EXIT_SUCCESS;
+}
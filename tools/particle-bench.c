@@ -0,0 +1,38 @@
+// Copyright 2023 David Lareau. This program is free software under the terms of the Zero Clause BSD.
+// gcc --pedantic -Wall -Werror-implicit-function-declaration -Wno-pointer-sign -O2 -I. -o particle-bench tools/particle-bench.c particle.c mem.c $(pkg-config --libs --cflags libxml-2.0) -lm
+
+// particle update cost at a steady population, on one core
+// - bursts keep replacing the dead so the count hovers around the target
+// - reports the update time per 60Hz frame against the 16.7ms frame budget
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include "particle.h"
+#include "time-util.h"
+
+int main(int argc, char * argv[]) {
+  int target = (argc > 1)? strtol(argv[1], NULL, 10) : 100000;
+  int frames = (argc > 2)? strtol(argv[2], NULL, 10) : 600;
+  const float dt = 1 / 60.0f;
+  struct particles particles;
+  particles_init(&particles, target * 2);
+  double update = 0, emit = 0, worst = 0;
+  long long alive = 0;
+  for(int frame = 0; frame < frames; frame++) {
+    double t0 = now();
+    // top up in bursts of 1000, like many effects going off at once
+    while(particles.size < target) particles_burst(&particles, 128, 112, 200, 300, 1000, 2, frame % 8);
+    double t1 = now();
+    particles_update(&particles, dt);
+    double t2 = now();
+    emit += t1 - t0;
+    update += t2 - t1;
+    if(t2 - t1 > worst) worst = t2 - t1;
+    alive += particles.size;
+  }
+  printf("%d frames, %.0f particles on average\n", frames, (double)alive / frames);
+  printf("update %.3f ms/frame (worst %.3f ms), emit %.3f ms/frame, %.1f%% of a 60Hz frame\n", update * 1000 / frames, worst * 1000, emit * 1000 / frames, (update + emit) / frames / dt * 100);
+  particles_free(&particles);
+  return EXIT_SUCCESS;
+}
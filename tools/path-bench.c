@@ -0,0 +1,123 @@
+// Copyright 2023 David Lareau. This program is free software under the terms of the Zero Clause BSD.
+// gcc --pedantic -Wall -Werror-implicit-function-declaration -Wno-pointer-sign -O2 -I. -o path-bench tools/path-bench.c path.c world.c game.c collision.c data-util.c mem.c pack.c $(pkg-config --libs --cflags libxml-2.0) -lm
+
+// query throughput of the pathfinding module on large synthetic worlds
+// - a single big grid, with point to point A*
+// - a big square of screens linked on all sides with a few warps, with cross screen routes
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "path.h"
+#include "mem.h"
+#include "time-util.h"
+
+static uint64_t rng_state = 0x2545F4914F6CDD1D;
+static uint32_t rng() {
+  rng_state ^= rng_state << 13;
+  rng_state ^= rng_state >> 7;
+  rng_state ^= rng_state << 17;
+  return (uint32_t)(rng_state >> 32);
+}
+
+static int random_open_cell(const bool * blocked, int cells) {
+  while(true) {
+    int cell = rng() % cells;
+    if(!blocked[cell]) return cell;
+  }
+}
+
+static void bench_grid(int side, double density, int queries) {
+  bool * blocked = malloc(sizeof(bool) * side * side);
+  for(int i = 0; i < side * side; i++) blocked[i] = rng() < density * UINT32_MAX;
+  struct path_grid grid = {side, side, blocked};
+  struct path_finder finder;
+  struct path path;
+  path_finder_init(&finder);
+  path_init(&path);
+  int found = 0;
+  size_t length = 0;
+  double t0 = now();
+  for(int i = 0; i < queries; i++) {
+    int from = random_open_cell(blocked, side * side);
+    int to = random_open_cell(blocked, side * side);
+    if(path_find(&finder, &grid, from, to, &path)) {
+      found++;
+      length += path.size;
+    }
+  }
+  double elapsed = now() - t0;
+  printf("grid %dx%d %.0f%% blocked: %d queries, %d found, %.1f cells/path, %.1f queries/s, %.3f ms/query\n", side, side, density * 100, queries, found, found? (double)length / found : 0, queries / elapsed, elapsed * 1000 / queries);
+  path_free(&path);
+  path_finder_free(&finder);
+  free(blocked);
+}
+
+static void bench_world(int side, double density, int queries) {
+  // screens in a side x side square, each linked to its neighbours, with a warp on one screen in eight
+  struct world world;
+  world.map_count = side * side;
+  world.nodes = mem_alloc(MEM_WORLD, sizeof(struct map_node) * world.map_count);
+  world.maps = mem_calloc(MEM_WORLD, world.map_count, sizeof(struct map_data *));
+  dict_init(&world.tileset.animated_tiles, sizeof(struct tile_animation), false, false);
+  dict_init(&world.tileset.blocking_tiles, 0, false, false);
+  world.tileset.image = NULL;
+  world.tileset.sources = NULL;
+  world.tileset.tile_count = 0;
+  world.owns_filenames = false;
+  for(int i = 0; i < world.map_count; i++) {
+    int x = i % side, y = i / side;
+    world.nodes[i] = (struct map_node){"synthetic.tmx", (y > 0)? i - side : -1, (y < side - 1)? i + side : -1, (x < side - 1)? i + 1 : -1, (x > 0)? i - 1 : -1};
+    struct map_data * map = mem_calloc(MEM_WORLD, 1, sizeof(struct map_data));
+    map->warp = -1;
+    for(int row = 0; row < MAP_ROW; row++) {
+      for(int col = 0; col < MAP_COL; col++) map->solid[row][col] = rng() < density * UINT32_MAX;
+    }
+    map->has_spawn = true;
+    map->spawn_x = (MAP_COL / 2) * TS + TS / 2;
+    map->spawn_y = (MAP_ROW / 2) * TS + TS / 2;
+    map->solid[MAP_ROW / 2][MAP_COL / 2] = false;
+    if(rng() % 8 == 0) {
+      map->warp = rng() % world.map_count;
+      int col = 1 + rng() % (MAP_COL - 2), row = 1 + rng() % (MAP_ROW - 2);
+      map->warp_rect = (struct rect){col * TS, row * TS, TS, TS};
+      map->solid[row][col] = false;
+    }
+    world.maps[i] = map;
+  }
+
+  struct rect collision = {1, 14, 12, 8}; // princess collision box
+  struct path_world paths;
+  struct route route;
+  path_world_init(&paths, &world, collision);
+  route_init(&route);
+  int found = 0;
+  size_t length = 0;
+  double t0 = now();
+  for(int i = 0; i < queries; i++) {
+    int from_map = rng() % world.map_count;
+    int to_map = rng() % world.map_count;
+    int from = random_open_cell(&world.maps[from_map]->solid[0][0], MAP_ROW * MAP_COL);
+    int to = random_open_cell(&world.maps[to_map]->solid[0][0], MAP_ROW * MAP_COL);
+    if(path_world_route(&paths, NULL, from_map, from, to_map, to, &route)) {
+      found++;
+      length += route.size;
+    }
+  }
+  double elapsed = now() - t0;
+  printf("world %dx%d screens %.0f%% blocked: %d routes, %d found, %.1f steps/route, %.1f routes/s, %.3f ms/route\n", side, side, density * 100, queries, found, found? (double)length / found : 0, queries / elapsed, elapsed * 1000 / queries);
+  route_free(&route);
+  path_world_free(&paths);
+  world_free(&world);
+}
+
+int main(int argc, char * argv[]) {
+  if(argc > 1) rng_state = strtoull(argv[1], NULL, 10) | 1;
+  bench_grid(256, .25, 2000);
+  bench_grid(1024, .25, 200);
+  bench_grid(1024, .35, 200);
+  bench_world(16, .2, 2000);
+  bench_world(64, .2, 200);
+  return EXIT_SUCCESS;
+}
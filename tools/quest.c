@@ -0,0 +1,216 @@
+// Copyright 2023 David Lareau. This program is free software under the terms of the Zero Clause BSD.
+// gcc --pedantic -Wall -Werror-implicit-function-declaration -Wno-pointer-sign -O2 -I. -o quest tools/quest.c path.c game.c world.c collision.c data-util.c replay.c mem.c pack.c $(pkg-config --libs --cflags libxml-2.0) -lm
+
+// plays the whole quest headless with the route planner and records the input, e.g. to train a pgo build
+// - each goal is an item to pick up or an npc to use, reached with path_world_route and re-planned on every new screen
+// - keys are decided from the state, stepped with the same fixed 1/60s steps as a headless --script run
+// - ends a few seconds after the heart is picked up, so the kaboom and winner effects have played
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "path.h"
+#include "replay.h"
+
+enum { FRAME_LIMIT = 60 * 60 * 20, STUCK_FRAMES = 120, WINNER_FRAMES = 60 * 4 };
+
+struct goal {
+  enum item item; // or NO_ITEM for the npc
+  enum npc npc;
+};
+
+// in quest order, an npc is used until its state moves on
+static const struct goal GOALS[] = {
+  {ITEM_CANE, NO_NPC}, {NO_ITEM, NPC_ELF}, {ITEM_KEY, NO_NPC}, {NO_ITEM, NPC_BOTTLE}, {ITEM_WATER, NO_NPC},
+  {NO_ITEM, NPC_FLAME}, {NO_ITEM, NPC_WIZARD}, {NO_ITEM, NPC_DRAGON}, {ITEM_HEART, NO_NPC},
+};
+
+static bool done(const struct game_state * state, const struct goal * goal) {
+  if(goal->item) return state->held_item == goal->item || state->ignored_items[goal->item];
+  switch(goal->npc) {
+    case NPC_ELF: return state->npc_state[NPC_ELF] == 2;
+    case NPC_BOTTLE: return state->npc_state[NPC_BOTTLE] == 1;
+    case NPC_FLAME: return state->npc_state[NPC_FLAME] == 1;
+    case NPC_WIZARD: return state->npc_state[NPC_WIZARD] == 2;
+    case NPC_DRAGON: return state->ignored_npcs[NPC_DRAGON];
+    default: return true;
+  }
+}
+
+struct agent {
+  struct world * world;
+  struct path_world paths;
+  struct route route;
+  struct game_state state;
+  struct replay replay;
+  uint8_t keys;
+  uint64_t frame;
+  double t0;
+};
+
+static void step(struct agent * self, uint8_t keys) {
+  if(self->frame == FRAME_LIMIT) { printf("quest not done after %d frames\n", FRAME_LIMIT); exit(EXIT_FAILURE); }
+  uint8_t previous_keys = self->keys;
+  self->keys = keys;
+  replay_push(&self->replay, self->frame, keys);
+  double t = self->frame / 60.0;
+  game_step(&self->state, self->world, keys, previous_keys, t - self->t0);
+  self->t0 = t;
+  self->frame++;
+}
+
+// keys walking the agent's position toward x, y, none once within half a step
+static uint8_t toward(const struct game_state * state, double x, double y) {
+  const double margin = 125 / 60.0 / 2;
+  uint8_t keys = 0;
+  if(x - state->px > margin) keys |= 1 << RIGHT;
+  if(state->px - x > margin) keys |= 1 << LEFT;
+  if(y - state->py > margin) keys |= 1 << DOWN;
+  if(state->py - y > margin) keys |= 1 << UP;
+  return keys;
+}
+
+static const uint8_t EXIT_KEYS[4] = {1 << UP, 1 << DOWN, 1 << RIGHT, 1 << LEFT}; // by enum edge
+
+// follows the route to its last cell, re-planning when the screen changes or progress stops
+static bool walk(struct agent * self, int to_map, int to_cell) {
+  struct game_state * state = &self->state;
+  while(true) {
+    if(state->next_map != -1) step(self, 0);
+    int from_cell = path_cell(&self->paths, state->px, state->py);
+    if(!path_world_route(&self->paths, state, state->map, from_cell, to_map, to_cell, &self->route)) return false;
+    int map = state->map;
+    size_t i = 0;
+    uint64_t progress_frame = self->frame;
+    bool leaving = false; // on the last cell of the screen, no longer centering on it
+    while(state->map == map && state->next_map == -1 && self->frame - progress_frame < STUCK_FRAMES) {
+      const struct route_step * s = &self->route.steps[i];
+      double x, y;
+      path_position(&self->paths, s->cell, &x, &y);
+      uint8_t keys = leaving? 0 : toward(state, x, y);
+      if(!keys) {
+        if(s->exit == EXIT_NONE && i + 1 < self->route.size) { i++; progress_frame = self->frame; continue; }
+        if(s->exit == EXIT_NONE) return true;
+        // last cell of the screen, walk off it or into the warp
+        leaving = true;
+        if(s->exit == EXIT_WARP) {
+          const struct rect * warp = &world_map(self->world, map)->warp_rect;
+          keys = toward(state, warp->x + warp->w / 2 - PRINCESS_COLLISION.x - PRINCESS_COLLISION.w / 2, warp->y + warp->h / 2 - PRINCESS_COLLISION.y - PRINCESS_COLLISION.h / 2);
+        } else {
+          keys = EXIT_KEYS[s->exit];
+        }
+      }
+      step(self, keys);
+    }
+  }
+}
+
+// the cell to stand on and the way to face target from it, cell * 4 + enum edge, closest to where the agent is and not tried yet
+static int approach(struct agent * self, int map, const struct rect * target, const bool * tried) {
+  const struct rect box = PRINCESS_COLLISION;
+  const struct rect forward = self->state.forward;
+  struct game_state * state = &self->state;
+  size_t best = SIZE_MAX;
+  int choice = -1;
+  int from_cell = path_cell(&self->paths, state->px, state->py);
+  for(int i = 0; i < MAP_ROW * MAP_COL; i++) {
+    double px, py;
+    path_position(&self->paths, i, &px, &py);
+    // same forward rects as game_step, which must touch target even a little off the cell, after the few steps facing it
+    struct rect f[4] = {
+      {px + box.x - (forward.w - box.w) / 2, py + box.y - forward.h, forward.w, forward.h},
+      {px + box.x - (forward.w - box.w) / 2, py + box.y + box.h, forward.w, forward.h},
+      {px + box.x + box.w, py + box.y - (forward.h - box.h) / 2, forward.w, forward.h},
+      {px + box.x - forward.w, py + box.y - (forward.h - box.h) / 2, forward.w, forward.h},
+    };
+    for(int k = 0; k < 4; k++) {
+      struct rect r = f[k];
+      if(k < 2) { r.x += 3; r.w -= 6; r.y += (k == 0)? -4 : 4; }
+      else { r.y += 3; r.h -= 6; r.x += (k == 3)? -4 : 4; }
+      if(tried[i * 4 + k] || !collides_2D(&r, target)) continue;
+      if(!path_world_route(&self->paths, state, state->map, from_cell, map, i, &self->route)) continue;
+      if(self->route.size >= best) continue;
+      best = self->route.size;
+      choice = i * 4 + k;
+    }
+  }
+  return choice;
+}
+
+static void press(struct agent * self, uint8_t keys, int frames) {
+  for(int i = 0; i < frames; i++) step(self, keys);
+}
+
+static void reach(struct agent * self, const struct goal * goal) {
+  const char * name = goal->item? ITEM_NAMES[goal->item] : NPC_NAMES[goal->npc];
+  int map = -1;
+  for(int i = 0; i < self->world->map_count && map == -1; i++) {
+    const struct map_data * data = world_map(self->world, i);
+    if(goal->item? data->item == goal->item : data->npc == goal->npc) map = i;
+  }
+  if(map == -1) { printf("no map has %s\n", name); exit(EXIT_FAILURE); }
+  const struct map_data * data = world_map(self->world, map);
+  const struct rect * target = goal->item? &data->item_rect : &data->npc_rect;
+  // walls in front of the target aren't known until bumping into them, so spots that got no reaction are tried once
+  bool tried[MAP_ROW * MAP_COL * 4] = {false};
+  while(self->state.npc == NPC_KABOOM) step(self, 0); // solid until it's done playing
+  while(!done(&self->state, goal)) {
+    int choice = approach(self, map, target, tried);
+    if(choice == -1 || !walk(self, map, choice / 4)) { printf("can't reach %s\n", name); exit(EXIT_FAILURE); }
+    // face it, then release the action key on it, and close whatever it says
+    struct game_state before = self->state;
+    press(self, EXIT_KEYS[choice % 4], 3);
+    press(self, 0, 4);
+    press(self, 1 << ACTION, 4);
+    press(self, 0, 20);
+    const struct game_state * after = &self->state;
+    tried[choice] = !after->message && after->held_item == before.held_item && after->npc == before.npc;
+    if(self->state.message) {
+      press(self, 1 << ACTION, 4);
+      press(self, 0, 10);
+    }
+  }
+  printf("%s at frame %llu\n", name, (unsigned long long)self->frame);
+}
+
+static void usage(const char * program) {
+  printf("usage: %s [--world file] replay\n", program);
+  printf("  --world  a .world file holding the quest's maps, instead of the quest\n");
+  printf("  replay   where to save the input played, e.g. train.replay for tools/build.sh\n");
+  exit(EXIT_FAILURE);
+}
+
+int main(int argc, char * argv[]) {
+  const char * world_filename = NULL;
+  const char * record_filename = NULL;
+  for(int i = 1; i < argc; i++) {
+    if(strcmp(argv[i], "--world") == 0 && i + 1 < argc) world_filename = argv[++i];
+    else if(argv[i][0] == '-' || record_filename) usage(argv[0]);
+    else record_filename = argv[i];
+  }
+  if(!record_filename) usage(argv[0]);
+
+  struct world world;
+  if(world_filename) world_init_file(&world, world_filename);
+  else world_init(&world);
+  world_load_all(&world);
+
+  struct agent agent = {&world};
+  path_world_init(&agent.paths, &world, PRINCESS_COLLISION);
+  route_init(&agent.route);
+  game_init(&agent.state);
+  replay_init(&agent.replay);
+  step(&agent, 0);
+  for(size_t i = 0; i < sizeof(GOALS) / sizeof(GOALS[0]); i++) reach(&agent, &GOALS[i]);
+  press(&agent, 0, WINNER_FRAMES);
+  // only key changes are saved, so end on one for the replay to last until here
+  step(&agent, 1 << DOWN);
+
+  if(!replay_save(&agent.replay, record_filename)) { printf("replay_save(%s) failed.\n", record_filename); exit(EXIT_FAILURE); }
+  printf("%llu frames, won: %d\n", (unsigned long long)agent.frame, agent.state.winner_t0 != -1);
+  replay_free(&agent.replay);
+  route_free(&agent.route);
+  path_world_free(&agent.paths);
+  world_free(&world);
+  return EXIT_SUCCESS;
+}
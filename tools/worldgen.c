@@ -0,0 +1,240 @@
+// Copyright 2023 David Lareau. This program is free software under the terms of the Zero Clause BSD.
+// gcc --pedantic -Wall -Werror-implicit-function-declaration -Wno-pointer-sign -O2 -I. -o zeldaish-worldgen tools/worldgen.c world.c collision.c data-util.c mem.c pack.c $(pkg-config --libs --cflags libxml-2.0) -lm
+
+// generates a world of any size for scaling benchmarks, loaded with --world dir/map.world by the game and the batch
+// - cols x rows screens laid out as a .world file, each screen linked to the ones next to it
+// - every screen has a floor, walls, animated tiles and extra layers at the given densities, using the tileset's own block and animation flags
+// - the border and a cross through the middle stay open so every screen can be walked through, and so the spawn in the middle is free
+// - items, npcs and warps to random screens are placed on a screen with the given probabilities
+// - the same seed generates the same world
+// - once written, the world is loaded back to check it
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <libxml/xmlmemory.h>
+#include <libxml/parser.h>
+#include "world.h"
+#include "mem.h"
+
+struct ids {
+  int size;
+  int * ids;
+};
+
+static void ids_add(struct ids * self, int id) {
+  self->ids = realloc(self->ids, sizeof(int) * (self->size + 1));
+  self->ids[self->size++] = id;
+}
+
+static uint64_t rng_state = 1;
+
+static uint32_t rng() {
+  rng_state ^= rng_state << 13;
+  rng_state ^= rng_state >> 7;
+  rng_state ^= rng_state << 17;
+  return rng_state >> 32;
+}
+
+static double rng_unit() {
+  return rng() / 4294967296.0;
+}
+
+static bool chance(double p) {
+  return rng_unit() < p;
+}
+
+static int pick(const struct ids * ids) {
+  return ids->ids[rng() % ids->size];
+}
+
+// sorts the tileset's tiles into walls (block), water and such (animated), and decorations (neither) among the quest's floor tiles
+static void read_tileset(const char * filename, struct ids * walls, struct ids * animated, struct ids * decor) {
+  static const int FLOOR_DECOR[] = {365, 367, 368, 405, 407, 408}; // grass tufts and flowers
+  struct dict blocking;
+  dict_init(&blocking, 0, false, false);
+  xmlDoc * doc = xmlParseFile(filename); if(!doc) { printf("xmlParseFile(%s) failed.\n", filename); exit(EXIT_FAILURE); }
+  xmlNode * root = xmlDocGetRootElement(doc); if(!root) { printf("xmlDocGetRootElement() is null.\n"); exit(EXIT_FAILURE); }
+  for(xmlNode * tile = root->xmlChildrenNode; tile; tile = tile->next) {
+    if(xmlStrcmp(tile->name, "tile") != 0) continue;
+    xmlChar * id = xmlGetProp(tile, "id");
+    xmlChar * type = xmlGetProp(tile, "type");
+    bool animation = false;
+    for(xmlNode * node = tile->xmlChildrenNode; node; node = node->next) animation |= xmlStrcmp(node->name, "animation") == 0;
+    bool block = type && xmlStrcmp(type, "block") == 0;
+    if(block) dict_set(&blocking, strtol(id, NULL, 10), true);
+    if(animation) ids_add(animated, strtol(id, NULL, 10));
+    else if(block) ids_add(walls, strtol(id, NULL, 10));
+    xmlFree(type);
+    xmlFree(id);
+  }
+  xmlFreeDoc(doc);
+  for(int i = 0; i < sizeof(FLOOR_DECOR) / sizeof(FLOOR_DECOR[0]); i++) if(!dict_get(&blocking, FLOOR_DECOR[i])) ids_add(decor, FLOOR_DECOR[i]);
+  dict_free(&blocking);
+  if(!walls->size || !animated->size || !decor->size) { printf("%s lacks block, animated or floor tiles\n", filename); exit(EXIT_FAILURE); }
+}
+
+// the tileset as seen from the directory of the maps
+static char * tileset_source(const char * dir, const char * tileset) {
+  char * source = malloc(PATH_MAX + strlen(dir) * 2 + strlen(tileset)); // at worst a ../ for every two characters of dir
+  if(dir[0] == '/' || tileset[0] == '/') {
+    if(!realpath(tileset, source)) { printf("realpath(%s) failed.\n", tileset); exit(EXIT_FAILURE); }
+    return source;
+  }
+  source[0] = '\0';
+  const char * p = dir;
+  while(*p) {
+    const char * end = strchr(p, '/');
+    size_t length = end? (size_t)(end - p) : strlen(p);
+    if(length == 2 && p[0] == '.' && p[1] == '.') { printf("the output directory can't go up with ..\n"); exit(EXIT_FAILURE); }
+    if(length && !(length == 1 && p[0] == '.')) strcat(source, "../");
+    p += length + (end != NULL);
+  }
+  strcat(source, tileset);
+  return source;
+}
+
+static bool open_cell(int row, int col) {
+  return row == 0 || row == MAP_ROW - 1 || col == 0 || col == MAP_COL - 1 || (row >= 4 && row <= 6) || (col >= 6 && col <= 9);
+}
+
+// a cell off the open border and cross, not used by another object yet
+static void object_cell(bool used[MAP_ROW][MAP_COL], int * row, int * col) {
+  do {
+    *row = 1 + rng() % (MAP_ROW - 2);
+    *col = 1 + rng() % (MAP_COL - 2);
+  } while(open_cell(*row, *col) || used[*row][*col]);
+  used[*row][*col] = true;
+}
+
+static void usage(const char * program) {
+  printf("usage: %s dir [--cols n] [--rows n] [--layers n] [--walls f] [--animated f] [--decor f] [--items f] [--npcs f] [--warps f] [--seed n] [--tileset file]\n", program);
+  printf("  dir         created if needed, gets map.world and one .tmx per screen\n");
+  printf("  --cols      screens across, default 16\n");
+  printf("  --rows      screens down, default 16\n");
+  printf("  --layers    tile layers per screen, the floor and walls take two, others are decorations, default 2, at most %d\n", LAYERS_CAPACITY);
+  printf("  --walls     fraction of cells with a wall, default 0.15\n");
+  printf("  --animated  fraction of cells with an animated tile, default 0.05\n");
+  printf("  --decor     fraction of cells with a decoration, on the floor and on each extra layer, default 0.25\n");
+  printf("  --items     chance of an item on a screen, default 0.25\n");
+  printf("  --npcs      chance of an npc on a screen, default 0.25\n");
+  printf("  --warps     chance of a warp to a random screen on a screen, default 0.125\n");
+  printf("  --seed      default 1\n");
+  printf("  --tileset   default overworld.tsx\n");
+  exit(EXIT_FAILURE);
+}
+
+int main(int argc, char * argv[]) {
+  mem_track_xml();
+  const char * dir = NULL;
+  int cols = 16, rows = 16, layers = 2;
+  double walls_density = .15, animated_density = .05, decor_density = .25;
+  double items_chance = .25, npcs_chance = .25, warps_chance = .125;
+  uint64_t seed = 1;
+  const char * tileset = "overworld.tsx";
+  for(int i = 1; i < argc; i++) {
+    if(strcmp(argv[i], "--cols") == 0 && i + 1 < argc) cols = strtol(argv[++i], NULL, 10);
+    else if(strcmp(argv[i], "--rows") == 0 && i + 1 < argc) rows = strtol(argv[++i], NULL, 10);
+    else if(strcmp(argv[i], "--layers") == 0 && i + 1 < argc) layers = strtol(argv[++i], NULL, 10);
+    else if(strcmp(argv[i], "--walls") == 0 && i + 1 < argc) walls_density = strtod(argv[++i], NULL);
+    else if(strcmp(argv[i], "--animated") == 0 && i + 1 < argc) animated_density = strtod(argv[++i], NULL);
+    else if(strcmp(argv[i], "--decor") == 0 && i + 1 < argc) decor_density = strtod(argv[++i], NULL);
+    else if(strcmp(argv[i], "--items") == 0 && i + 1 < argc) items_chance = strtod(argv[++i], NULL);
+    else if(strcmp(argv[i], "--npcs") == 0 && i + 1 < argc) npcs_chance = strtod(argv[++i], NULL);
+    else if(strcmp(argv[i], "--warps") == 0 && i + 1 < argc) warps_chance = strtod(argv[++i], NULL);
+    else if(strcmp(argv[i], "--seed") == 0 && i + 1 < argc) seed = strtoull(argv[++i], NULL, 10);
+    else if(strcmp(argv[i], "--tileset") == 0 && i + 1 < argc) tileset = argv[++i];
+    else if(argv[i][0] == '-' || dir) usage(argv[0]);
+    else dir = argv[i];
+  }
+  if(!dir || cols < 1 || rows < 1 || layers < 2 || layers > LAYERS_CAPACITY) usage(argv[0]);
+  rng_state = seed * 0x9E3779B97F4A7C15 | 1;
+
+  struct ids walls = {0}, animated = {0}, decor = {0};
+  read_tileset(tileset, &walls, &animated, &decor);
+  char * source = tileset_source(dir, tileset);
+  if(mkdir(dir, 0755) != 0 && errno != EEXIST) { printf("mkdir(%s) failed.\n", dir); exit(EXIT_FAILURE); }
+  char path[strlen(dir) + 64];
+
+  // the layout, map 0 first as it holds the start
+  int count = cols * rows;
+  snprintf(path, sizeof(path), "%s/map.world", dir);
+  FILE * f = fopen(path, "w"); if(!f) { printf("fopen(%s) failed.\n", path); exit(EXIT_FAILURE); }
+  fprintf(f, "{\n  \"maps\": [\n");
+  for(int i = 0; i < count; i++) {
+    fprintf(f, "    {\n      \"fileName\": \"map_%d.tmx\",\n      \"x\": %d,\n      \"y\": %d\n    }%s\n", i, (i % cols) * MAP_COL * TS, (i / cols) * MAP_ROW * TS, (i < count - 1)? "," : "");
+  }
+  fprintf(f, "  ],\n  \"type\": \"world\"\n}\n");
+  if(fclose(f) != 0) { printf("fclose(%s) failed.\n", path); exit(EXIT_FAILURE); }
+
+  // the screens
+  int tiles[LAYERS_CAPACITY][MAP_ROW][MAP_COL];
+  int item_count = 0, npc_count = 0, warp_count = 0, animated_count = 0;
+  for(int i = 0; i < count; i++) {
+    memset(tiles, 0, sizeof(tiles));
+    bool used[MAP_ROW][MAP_COL] = {0};
+    for(int row = 0; row < MAP_ROW; row++) {
+      for(int col = 0; col < MAP_COL; col++) {
+        tiles[0][row][col] = 1 + (chance(decor_density)? pick(&decor) : 0);
+        if(!open_cell(row, col)) {
+          double r = rng_unit();
+          if(r < animated_density) { tiles[1][row][col] = 1 + pick(&animated); animated_count++; }
+          else if(r < animated_density + walls_density) tiles[1][row][col] = 1 + pick(&walls);
+        }
+        for(int k = 2; k < layers; k++) if(chance(decor_density)) tiles[k][row][col] = 1 + pick(&decor);
+      }
+    }
+    // objects, on cells cleared of walls
+    int item_row = 0, item_col = 0, npc_row = 0, npc_col = 0, warp_row = 0, warp_col = 0;
+    enum item item = chance(items_chance)? 1 + rng() % (ITEM_COUNT - 1) : NO_ITEM;
+    enum npc npc = chance(npcs_chance)? NPC_ELF + rng() % (NPC_DRAGON - NPC_ELF + 1) : NO_NPC; // not the kaboom, which is the dragon's end
+    int warp = chance(warps_chance)? rng() % count : -1;
+    if(item) object_cell(used, &item_row, &item_col);
+    if(npc) object_cell(used, &npc_row, &npc_col);
+    if(warp != -1) object_cell(used, &warp_row, &warp_col);
+    for(int row = 0; row < MAP_ROW; row++) {
+      for(int col = 0; col < MAP_COL; col++) if(used[row][col]) tiles[1][row][col] = 0;
+    }
+    item_count += item != NO_ITEM;
+    npc_count += npc != NO_NPC;
+    warp_count += warp != -1;
+
+    snprintf(path, sizeof(path), "%s/map_%d.tmx", dir, i);
+    f = fopen(path, "w"); if(!f) { printf("fopen(%s) failed.\n", path); exit(EXIT_FAILURE); }
+    fprintf(f, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+    fprintf(f, "<map version=\"1.2\" orientation=\"orthogonal\" renderorder=\"right-down\" width=\"%d\" height=\"%d\" tilewidth=\"%d\" tileheight=\"%d\" infinite=\"0\" nextlayerid=\"%d\" nextobjectid=\"5\">\n", MAP_COL, MAP_ROW, TS, TS, layers + 2);
+    fprintf(f, " <tileset firstgid=\"1\" source=\"%s\"/>\n", source);
+    for(int k = 0; k < layers; k++) {
+      fprintf(f, " <layer id=\"%d\" name=\"%s\" width=\"%d\" height=\"%d\">\n  <data encoding=\"csv\">\n", k + 1, (k == 0)? "floor" : (k == 1)? "walls" : "decor", MAP_COL, MAP_ROW);
+      for(int row = 0; row < MAP_ROW; row++) {
+        for(int col = 0; col < MAP_COL; col++) fprintf(f, "%d%s", tiles[k][row][col], (row < MAP_ROW - 1 || col < MAP_COL - 1)? "," : "");
+        fprintf(f, "\n");
+      }
+      fprintf(f, "</data>\n </layer>\n");
+    }
+    fprintf(f, " <objectgroup id=\"%d\" name=\"objects\">\n", layers + 1);
+    fprintf(f, "  <object id=\"1\" name=\"start\" type=\"spawn\" x=\"%d\" y=\"%d\">\n   <point/>\n  </object>\n", (MAP_COL / 2 - 1) * TS + TS / 2, (MAP_ROW / 2 - 1) * TS + TS / 2);
+    if(item) fprintf(f, "  <object id=\"2\" name=\"%s\" type=\"item\" x=\"%d\" y=\"%d\">\n   <point/>\n  </object>\n", ITEM_NAMES[item], item_col * TS + TS / 2, item_row * TS + TS / 2);
+    if(npc) fprintf(f, "  <object id=\"3\" name=\"%s\" type=\"npc\" x=\"%d\" y=\"%d\">\n   <point/>\n  </object>\n", NPC_NAMES[npc], npc_col * TS + TS / 2, npc_row * TS + TS / 2);
+    if(warp != -1) fprintf(f, "  <object id=\"4\" name=\"map_%d\" type=\"warp\" x=\"%d\" y=\"%d\" width=\"%d\" height=\"%d\"/>\n", warp, warp_col * TS, warp_row * TS, TS, TS);
+    fprintf(f, " </objectgroup>\n</map>\n");
+    if(fclose(f) != 0) { printf("fclose(%s) failed.\n", path); exit(EXIT_FAILURE); }
+  }
+
+  // load it back like the game would
+  snprintf(path, sizeof(path), "%s/map.world", dir);
+  struct world world;
+  world_init_file(&world, path);
+  world_load_all(&world);
+  printf("%s: %d screens (%dx%d), %d layers, %d animated tiles, %d items, %d npcs, %d warps, %lld KB loaded\n", path, count, cols, rows, layers, animated_count, item_count, npc_count, warp_count, mem_current(MEM_WORLD) / 1024);
+  world_free(&world);
+
+  free(source);
+  free(walls.ids);
+  free(animated.ids);
+  free(decor.ids);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,74 @@
+// Copyright 2023 David Lareau. This program is free software under the terms of the Zero Clause BSD.
+#include <stdio.h>
+#include <time.h>
+#include "worker.h"
+#include "time-util.h"
+
+static void * work(void * arg) {
+  struct sim_worker * self = arg;
+  pthread_mutex_lock(&self->lock);
+  while(true) {
+    while(self->phase != WORKER_SUBMITTED && self->phase != WORKER_QUIT) pthread_cond_wait(&self->cond, &self->lock);
+    if(self->phase == WORKER_QUIT) break;
+    // the caller doesn't touch the worker's fields until the step is done, so the lock isn't needed meanwhile
+    pthread_mutex_unlock(&self->lock);
+    double t0 = now();
+    self->events = game_step(&self->state, self->world, self->keys, self->previous_keys, self->delta_time);
+    self->step_time = now() - t0;
+    pthread_mutex_lock(&self->lock);
+    self->phase = WORKER_DONE;
+    pthread_cond_broadcast(&self->cond);
+  }
+  pthread_mutex_unlock(&self->lock);
+  return NULL;
+}
+
+void sim_worker_start(struct sim_worker * self, const struct world * world) {
+  self->world = world;
+  self->phase = WORKER_IDLE;
+  self->step_time = 0;
+  pthread_mutex_init(&self->lock, NULL);
+  pthread_cond_init(&self->cond, NULL);
+  if(pthread_create(&self->thread, NULL, work, self)) { printf("pthread_create() failed.\n"); exit(EXIT_FAILURE); }
+}
+
+void sim_worker_stop(struct sim_worker * self) {
+  pthread_mutex_lock(&self->lock);
+  while(self->phase == WORKER_SUBMITTED) pthread_cond_wait(&self->cond, &self->lock);
+  self->phase = WORKER_QUIT;
+  pthread_cond_broadcast(&self->cond);
+  pthread_mutex_unlock(&self->lock);
+  pthread_join(self->thread, NULL);
+  pthread_cond_destroy(&self->cond);
+  pthread_mutex_destroy(&self->lock);
+}
+
+void sim_worker_submit(struct sim_worker * self, const struct game_state * from, uint8_t keys, uint8_t previous_keys, double delta_time) {
+  pthread_mutex_lock(&self->lock);
+  if(self->phase == WORKER_SUBMITTED) { printf("sim_worker_submit() with a step in flight.\n"); exit(EXIT_FAILURE); }
+  self->state = *from;
+  self->keys = keys;
+  self->previous_keys = previous_keys;
+  self->delta_time = delta_time;
+  self->phase = WORKER_SUBMITTED;
+  pthread_cond_broadcast(&self->cond);
+  pthread_mutex_unlock(&self->lock);
+}
+
+bool sim_worker_done(struct sim_worker * self) {
+  pthread_mutex_lock(&self->lock);
+  bool done = self->phase == WORKER_DONE;
+  pthread_mutex_unlock(&self->lock);
+  return done;
+}
+
+struct game_events sim_worker_wait(struct sim_worker * self, struct game_state * to) {
+  pthread_mutex_lock(&self->lock);
+  if(self->phase == WORKER_IDLE) { printf("sim_worker_wait() without a step submitted.\n"); exit(EXIT_FAILURE); }
+  while(self->phase != WORKER_DONE) pthread_cond_wait(&self->cond, &self->lock);
+  self->phase = WORKER_IDLE;
+  *to = self->state;
+  struct game_events events = self->events;
+  pthread_mutex_unlock(&self->lock);
+  return events;
+}
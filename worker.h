@@ -0,0 +1,30 @@
+#pragma once
+// Copyright 2023 David Lareau. This program is free software under the terms of the Zero Clause BSD.
+#include <pthread.h>
+#include "game.h"
+
+// runs game steps on a thread of its own, so the next step can advance while the main thread draws the current one
+// - the worker steps its own copy of the state (the back buffer), the caller's state is only read by the caller (the front buffer)
+// - one step in flight at a time: submit, do something else, then wait for it
+
+enum worker_phase { WORKER_IDLE, WORKER_SUBMITTED, WORKER_DONE, WORKER_QUIT };
+
+struct sim_worker {
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  enum worker_phase phase;
+  const struct world * world;
+  struct game_state state;
+  uint8_t keys;
+  uint8_t previous_keys;
+  double delta_time;
+  struct game_events events;
+  double step_time; // seconds the last step took on the worker
+};
+
+void sim_worker_start(struct sim_worker * self, const struct world * world);
+void sim_worker_stop(struct sim_worker * self);
+void sim_worker_submit(struct sim_worker * self, const struct game_state * from, uint8_t keys, uint8_t previous_keys, double delta_time);
+bool sim_worker_done(struct sim_worker * self); // the step submitted is over, step_time is its duration
+struct game_events sim_worker_wait(struct sim_worker * self, struct game_state * to);
@@ -0,0 +1,466 @@
+// Copyright 2023 David Lareau. This program is free software under the terms of the Zero Clause BSD.
+#include <stdio.h>
+#include <string.h>
+#include <libxml/xmlmemory.h>
+#include <libxml/parser.h>
+#include "world.h"
+#include "mem.h"
+#include "pack.h"
+
+const char * ITEM_NAMES[ITEM_COUNT] = {NULL, "cane", "key", "bottle", "water", "heart", "staff", "spell"};
+const char * NPC_NAMES[NPC_COUNT] = {NULL, "elf", "bottle", "flame", "wizard", "garden", "dragon", "kaboom"};
+const bool NPC_SOLID[NPC_COUNT] = {false, true, true, true, true, false, true, true};
+
+static int name_index(const char ** names, int count, const char * name) {
+  for(int i = 1; i < count; i++) if(strcmp(names[i], name) == 0) return i;
+  return 0;
+}
+
+static void init_tileset(struct world * self) {
+  self->tileset.image = NULL;
+  self->tileset.sources = NULL;
+  self->tileset.tile_count = 0;
+  dict_init(&self->tileset.animated_tiles, sizeof(struct tile_animation), false, false);
+  dict_init(&self->tileset.blocking_tiles, 0, false, false);
+}
+
+void world_init(struct world * self) {
+  // the quest starts at map 0
+  enum { FOUNTAIN, FOREST, ELF, FIRE, DRAGON, WIZARD, CAVE, COUNT };
+  const char * filenames[COUNT] = {"fountain.tmx", "forest.tmx", "elf.tmx", "fire.tmx", "dragon.tmx", "wizard.tmx", "cave.tmx"};
+  self->map_count = COUNT;
+  self->nodes = mem_alloc(MEM_WORLD, sizeof(struct map_node) * COUNT);
+  for(int i = 0; i < COUNT; i++) self->nodes[i] = (struct map_node){filenames[i], -1, -1, -1, -1};
+  struct map_node * n = self->nodes;
+  n[FOUNTAIN].west = ELF; n[ELF].east = FOUNTAIN;
+  n[FOUNTAIN].north = DRAGON; n[DRAGON].south = FOUNTAIN;
+  n[DRAGON].west = FIRE; n[FIRE].east = DRAGON;
+  n[DRAGON].east = WIZARD; n[WIZARD].west = DRAGON;
+  n[WIZARD].south = FOREST; n[FOREST].north = WIZARD;
+  self->maps = mem_calloc(MEM_WORLD, COUNT, sizeof(struct map_data *));
+  self->owns_filenames = false;
+  init_tileset(self);
+  world_map(self, FOUNTAIN);
+}
+
+// filename relative to the directory of base, with dir/.. folded away so names stay the ones in the pack
+static char * resolve(const char * base, const char * filename) {
+  size_t dir_length = 0;
+  if(filename[0] != '/') {
+    const char * slash = strrchr(base, '/');
+    if(slash) dir_length = slash - base + 1;
+  }
+  char * path = mem_alloc(MEM_WORLD, dir_length + strlen(filename) + 1);
+  memcpy(path, base, dir_length);
+  strcpy(path + dir_length, filename);
+  // fold in place, out never passes p
+  char * out = path;
+  char * p = path;
+  if(*p == '/') { out++; p++; }
+  char * first = out; // start of the first segment that can be folded
+  while(*p) {
+    char * end = strchr(p, '/');
+    size_t length = end? (size_t)(end - p) : strlen(p);
+    bool parent = length == 2 && p[0] == '.' && p[1] == '.';
+    bool after_parent = out - first >= 3 && strncmp(out - 3, "../", 3) == 0 && (out - 3 == first || out[-4] == '/'); // nothing left to fold
+    if((length == 0) || (length == 1 && p[0] == '.')) {
+      // skip
+    } else if(parent && out > first && !after_parent) {
+      // drop the previous segment
+      out--;
+      while(out > first && out[-1] != '/') out--;
+    } else {
+      memmove(out, p, length);
+      out += length;
+      if(end) *out++ = '/';
+    }
+    p += length + (end != NULL);
+  }
+  *out = '\0';
+  return path;
+}
+
+// screen index at a grid position, -1 if none
+struct screen_grid {
+  int col0, row0, cols, rows;
+  int * maps;
+};
+
+static int grid_at(const struct screen_grid * grid, int col, int row) {
+  col -= grid->col0;
+  row -= grid->row0;
+  if(col < 0 || col >= grid->cols || row < 0 || row >= grid->rows) return -1;
+  return grid->maps[row * grid->cols + col];
+}
+
+// value of "key": in the json between start and end, or fallback
+static double json_number(const char * start, const char * end, const char * key, double fallback) {
+  size_t length = strlen(key);
+  for(const char * p = start; p + length + 2 < end; p++) {
+    if(*p != '"' || strncmp(p + 1, key, length) != 0 || p[length + 1] != '"') continue;
+    p += length + 2;
+    while(p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r' || *p == ':')) p++;
+    return strtod(p, NULL);
+  }
+  return fallback;
+}
+
+void world_init_file(struct world * self, const char * filename) {
+  // whole file as a string, from the pack or the disk
+  size_t size;
+  const char * packed = pack_get(filename, &size);
+  char * json;
+  if(packed) {
+    json = mem_alloc(MEM_WORLD, size + 1);
+    memcpy(json, packed, size);
+  } else {
+    FILE * f = fopen(filename, "rb"); if(!f) { printf("fopen(%s) failed.\n", filename); exit(EXIT_FAILURE); }
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    json = mem_alloc(MEM_WORLD, size + 1);
+    if(fread(json, 1, size, f) != size) { printf("fread(%s) failed.\n", filename); exit(EXIT_FAILURE); }
+    fclose(f);
+  }
+  json[size] = '\0';
+
+  // each map is an object with "fileName", "x" and "y", in any order
+  const char * key = "\"fileName\"";
+  self->map_count = 0;
+  for(const char * p = strstr(json, key); p; p = strstr(p + 1, key)) self->map_count++;
+  if(self->map_count == 0) { printf("no maps in %s\n", filename); exit(EXIT_FAILURE); }
+  self->nodes = mem_alloc(MEM_WORLD, sizeof(struct map_node) * self->map_count);
+  int * x = mem_alloc(MEM_WORLD, sizeof(int) * self->map_count);
+  int * y = mem_alloc(MEM_WORLD, sizeof(int) * self->map_count);
+  const char * p = json;
+  for(int i = 0; i < self->map_count; i++) {
+    p = strstr(p, key);
+    const char * start = p;
+    while(start > json && *start != '{') start--;
+    const char * end = strchr(p, '}'); if(!end) { printf("unterminated map in %s\n", filename); exit(EXIT_FAILURE); }
+    p += strlen(key);
+    const char * a = strchr(p, '"'); if(!a || a > end) { printf("invalid fileName in %s\n", filename); exit(EXIT_FAILURE); }
+    const char * b = strchr(a + 1, '"'); if(!b || b > end) { printf("invalid fileName in %s\n", filename); exit(EXIT_FAILURE); }
+    char name[b - a];
+    memcpy(name, a + 1, b - a - 1);
+    name[b - a - 1] = '\0';
+    self->nodes[i] = (struct map_node){resolve(filename, name), -1, -1, -1, -1};
+    x[i] = json_number(start, end, "x", 0);
+    y[i] = json_number(start, end, "y", 0);
+    p = end;
+  }
+  mem_free(json);
+
+  // link screens that touch, by position on the grid of screen sizes
+  // off grid screens, like the quest's cave, are only reachable by warp
+  const int W = MAP_COL * TS, H = MAP_ROW * TS;
+  struct screen_grid grid = {INT32_MAX, INT32_MAX, 0, 0, NULL};
+  int col1 = INT32_MIN, row1 = INT32_MIN;
+  for(int i = 0; i < self->map_count; i++) {
+    if(x[i] % W || y[i] % H) continue;
+    int col = x[i] / W, row = y[i] / H;
+    if(col < grid.col0) grid.col0 = col;
+    if(row < grid.row0) grid.row0 = row;
+    if(col > col1) col1 = col;
+    if(row > row1) row1 = row;
+  }
+  if(col1 != INT32_MIN) {
+    long long cells = (long long)(col1 - grid.col0 + 1) * (row1 - grid.row0 + 1);
+    if(cells > 16 * 1024 * 1024) { printf("screens of %s are spread too far apart\n", filename); exit(EXIT_FAILURE); }
+    grid.cols = col1 - grid.col0 + 1;
+    grid.rows = row1 - grid.row0 + 1;
+    grid.maps = mem_alloc(MEM_WORLD, sizeof(int) * cells);
+    for(long long i = 0; i < cells; i++) grid.maps[i] = -1;
+  }
+  for(int i = 0; i < self->map_count; i++) {
+    if(x[i] % W || y[i] % H) continue;
+    grid.maps[(y[i] / H - grid.row0) * grid.cols + (x[i] / W - grid.col0)] = i;
+  }
+  for(int i = 0; i < self->map_count; i++) {
+    if(x[i] % W || y[i] % H) continue;
+    int col = x[i] / W, row = y[i] / H;
+    struct map_node * n = &self->nodes[i];
+    n->north = grid_at(&grid, col, row - 1);
+    n->south = grid_at(&grid, col, row + 1);
+    n->east = grid_at(&grid, col + 1, row);
+    n->west = grid_at(&grid, col - 1, row);
+  }
+  mem_free(grid.maps);
+  mem_free(y);
+  mem_free(x);
+
+  self->maps = mem_calloc(MEM_WORLD, self->map_count, sizeof(struct map_data *));
+  self->owns_filenames = true;
+  init_tileset(self);
+  world_map(self, 0);
+}
+
+void world_free(struct world * self) {
+  for(int i = 0; i < self->map_count; i++) {
+    if(self->maps[i]) mem_free(self->maps[i]->layers);
+    mem_free(self->maps[i]);
+    if(self->owns_filenames) mem_free((char *)self->nodes[i].filename);
+  }
+  mem_free(self->maps);
+  mem_free(self->nodes);
+  for(size_t i = 0; i < self->tileset.animated_tiles.size; i++) {
+    struct tile_animation * anim = dict_get_by_index(&self->tileset.animated_tiles, i);
+    mem_free(anim->ids);
+    mem_free(anim->durations);
+  }
+  dict_free(&self->tileset.animated_tiles);
+  dict_free(&self->tileset.blocking_tiles);
+  mem_free(self->tileset.image);
+  mem_free(self->tileset.sources);
+}
+
+int world_find(struct world * self, const char * name) {
+  size_t length = strlen(name);
+  for(int i = 0; i < self->map_count; i++) {
+    const char * filename = self->nodes[i].filename;
+    const char * slash = strrchr(filename, '/');
+    if(slash) filename = slash + 1;
+    if(strncmp(filename, name, length) == 0 && strcmp(filename + length, ".tmx") == 0) return i;
+  }
+  return -1;
+}
+
+static void parse_tileset(struct tileset * self, const char * filename) {
+  xmlDoc * tileset = pack_xml(filename); if(!tileset) { printf("pack_xml(%s) failed.\n", filename); exit(EXIT_FAILURE); }
+  xmlNode * tcur = xmlDocGetRootElement(tileset); if(!tcur) { printf("xmlDocGetRootElement() is null.\n"); exit(EXIT_FAILURE); }
+  xmlChar * str_columns = xmlGetProp(tcur, "columns");
+  xmlChar * str_count = xmlGetProp(tcur, "tilecount");
+  xmlChar * str_width = xmlGetProp(tcur, "tilewidth");
+  xmlChar * str_height = xmlGetProp(tcur, "tileheight");
+  xmlChar * str_margin = xmlGetProp(tcur, "margin");
+  xmlChar * str_spacing = xmlGetProp(tcur, "spacing");
+  if(!str_columns || !str_count) { printf("%s lacks columns or tilecount\n", filename); exit(EXIT_FAILURE); }
+  if((str_width && strtol(str_width, NULL, 10) != TS) || (str_height && strtol(str_height, NULL, 10) != TS)) { printf("%s tiles are not %dx%d\n", filename, TS, TS); exit(EXIT_FAILURE); }
+  self->columns = strtol(str_columns, NULL, 10);
+  self->tile_count = strtol(str_count, NULL, 10);
+  self->margin = str_margin? strtol(str_margin, NULL, 10) : 0;
+  self->spacing = str_spacing? strtol(str_spacing, NULL, 10) : 0;
+  xmlFree(str_spacing);
+  xmlFree(str_margin);
+  xmlFree(str_height);
+  xmlFree(str_width);
+  xmlFree(str_count);
+  xmlFree(str_columns);
+  if(self->columns <= 0 || self->tile_count <= 0) { printf("%s has no tiles\n", filename); exit(EXIT_FAILURE); }
+  // where each tile is in the image, so drawing is a lookup
+  self->sources = mem_alloc(MEM_WORLD, sizeof(struct rect) * self->tile_count);
+  for(int i = 0; i < self->tile_count; i++) {
+    self->sources[i] = (struct rect){self->margin + (TS + self->spacing) * (i % self->columns), self->margin + (TS + self->spacing) * (i / self->columns), TS, TS};
+  }
+  tcur = tcur->xmlChildrenNode;
+  while(tcur != NULL) {
+    if(xmlStrcmp(tcur->name, "image") == 0) {
+      xmlChar * source = xmlGetProp(tcur, "source");
+      self->image = resolve(filename, source);
+      xmlFree(source);
+    }
+    else if(xmlStrcmp(tcur->name, "tile") == 0) {
+      xmlChar * id = xmlGetProp(tcur, "id");
+      // store blocking tiles
+      xmlChar * type = xmlGetProp(tcur, "type");
+      if(type && xmlStrcmp(type, "block") == 0) dict_set(&self->blocking_tiles, strtol(id, NULL, 10), true);
+      xmlFree(type);
+      // store animations
+      xmlNode * acur = tcur->xmlChildrenNode;
+      while(acur != NULL) {
+        if(xmlStrcmp(acur->name, "animation") == 0) {
+          // count how many frames
+          struct tile_animation anim = {0};
+          xmlNode * fcur = acur->xmlChildrenNode;
+          while(fcur != NULL) {
+            if(xmlStrcmp(fcur->name, "frame") == 0) anim.size++;
+            fcur = fcur->next;
+          }
+          // alloc and store in dictionary
+          anim.ids = mem_alloc(MEM_WORLD, sizeof(int) * anim.size);
+          anim.durations = mem_alloc(MEM_WORLD, sizeof(uint64_t) * anim.size);
+          // populate ids/durations
+          fcur = acur->xmlChildrenNode;
+          int i = 0;
+          while(fcur != NULL) {
+            if(xmlStrcmp(fcur->name, "frame") == 0) {
+              xmlChar * t = xmlGetProp(fcur, "tileid");
+              xmlChar * d = xmlGetProp(fcur, "duration");
+              anim.ids[i] = strtol(t, NULL, 10);
+              if(anim.ids[i] < 0 || anim.ids[i] >= self->tile_count) { printf("%s animates to tile %d, beyond the tileset\n", filename, anim.ids[i]); exit(EXIT_FAILURE); }
+              anim.durations[i] = strtol(d, NULL, 10);
+              anim.total_duration += anim.durations[i];
+              i++;
+              xmlFree(d);
+              xmlFree(t);
+            }
+            fcur = fcur->next;
+          }
+          dict_set(&self->animated_tiles, strtol(id, NULL, 10), (intptr_t)&anim);
+        }
+        acur = acur->next;
+      }
+      xmlFree(id);
+    }
+    tcur = tcur->next;
+  }
+  xmlFreeDoc(tileset);
+}
+
+// object rect, where a point object is a tile centered on it
+static struct rect parse_rect(xmlNode * node) {
+  struct rect r;
+  xmlChar * x = xmlGetProp(node, "x");
+  xmlChar * y = xmlGetProp(node, "y");
+  xmlChar * w = xmlGetProp(node, "width");
+  xmlChar * h = xmlGetProp(node, "height");
+  r.x = strtod(x, NULL);
+  if(w) {
+    r.w = strtod(w, NULL);
+  } else {
+    r.w = TS;
+    r.x -= TS / 2;
+  }
+  r.y = strtod(y, NULL);
+  if(h) {
+    r.h = strtod(h, NULL);
+  } else {
+    r.h = TS;
+    r.y -= TS / 2;
+  }
+  xmlFree(h);
+  xmlFree(w);
+  xmlFree(y);
+  xmlFree(x);
+  return r;
+}
+
+static struct map_data * parse_map(struct world * world, const char * filename) {
+  struct map_data * self = mem_calloc(MEM_WORLD, 1, sizeof(struct map_data));
+  self->warp = -1;
+  xmlDoc * doc = pack_xml(filename); if(!doc) { printf("pack_xml(%s) failed.\n", filename); exit(EXIT_FAILURE); }
+  xmlNode * mcur = xmlDocGetRootElement(doc); if(!mcur) { printf("xmlDocGetRootElement() is null.\n"); exit(EXIT_FAILURE); }
+  mcur = mcur->xmlChildrenNode;
+  while(mcur != NULL) {
+    // load tileset
+    if(!world->tileset.image && xmlStrcmp(mcur->name, "tileset") == 0) {
+      xmlChar * source = xmlGetProp(mcur, "source");
+      char * path = resolve(filename, source);
+      parse_tileset(&world->tileset, path);
+      mem_free(path);
+      xmlFree(source);
+    }
+    // layers
+    else if(xmlStrcmp(mcur->name, "layer") == 0) {
+      xmlNode * node = mcur->xmlChildrenNode;
+      while(node != NULL) {
+        if(xmlStrcmp(node->name, "data") == 0) {
+          if(self->layers_size == LAYERS_CAPACITY) { printf("layers array full\n"); exit(EXIT_FAILURE); }
+          int index = self->layers_size++;
+          self->layers = mem_realloc(MEM_WORLD, self->layers, self->layers_size, sizeof(*self->layers));
+          if(!self->layers) { printf("out of mem\n"); exit(EXIT_FAILURE); }
+          memset(self->layers[index], 0, sizeof(*self->layers));
+          xmlChar * data = xmlNodeListGetString(doc, node->xmlChildrenNode, 1);
+          char * p = data;
+          int row = 0, col = 0;
+          while(*p) {
+            // change row
+            if(*p == '\n' && col > 0) {
+              row++;
+              col = 0;
+              p++;
+            } else {
+              char * end;
+              int tile = strtol(p, &end, 10);
+              // if the number is valid, store it
+              if(end != p) {
+                if(row >= MAP_ROW) { printf("too many row in map data\n"); exit(EXIT_FAILURE); }
+                if(col >= MAP_COL) { printf("too many col in map data\n"); exit(EXIT_FAILURE); }
+                self->layers[index][row][col++] = tile;
+                p = end;
+              }
+              // if it wasn't a number, skip over
+              else { p++; }
+            }
+          }
+          xmlFree(data);
+        }
+        node = node->next;
+      }
+    }
+    // object
+    else if(xmlStrcmp(mcur->name, "objectgroup") == 0) {
+      xmlNode * node = mcur->xmlChildrenNode;
+      while(node != NULL) {
+        if(xmlStrcmp(node->name, "object") == 0) {
+          xmlChar * type = xmlGetProp(node, "type");
+          if(type) {
+            if(xmlStrcmp(type, "spawn") == 0) {
+              xmlChar * x = xmlGetProp(node, "x");
+              xmlChar * y = xmlGetProp(node, "y");
+              self->has_spawn = true;
+              self->spawn_x = strtod(x, NULL);
+              self->spawn_y = strtod(y, NULL);
+              xmlFree(y);
+              xmlFree(x);
+            }
+            else if(xmlStrcmp(type, "warp") == 0) {
+              xmlChar * x = xmlGetProp(node, "x");
+              xmlChar * y = xmlGetProp(node, "y");
+              xmlChar * w = xmlGetProp(node, "width");
+              xmlChar * h = xmlGetProp(node, "height");
+              xmlChar * name = xmlGetProp(node, "name");
+              self->warp_rect.x = strtod(x, NULL);
+              self->warp_rect.w = strtod(w, NULL);
+              self->warp_rect.y = strtod(y, NULL);
+              self->warp_rect.h = strtod(h, NULL);
+              self->warp = world_find(world, name);
+              if(self->warp == -1) { printf("invalid warp name %s\n", name); exit(EXIT_FAILURE); }
+              xmlFree(name);
+              xmlFree(h);
+              xmlFree(w);
+              xmlFree(y);
+              xmlFree(x);
+            }
+            else if(xmlStrcmp(type, "item") == 0) {
+              xmlChar * name = xmlGetProp(node, "name");
+              self->item = name_index(ITEM_NAMES, ITEM_COUNT, name);
+              self->item_rect = parse_rect(node);
+              xmlFree(name);
+            } else if(xmlStrcmp(type, "npc") == 0) {
+              xmlChar * name = xmlGetProp(node, "name");
+              self->npc = name_index(NPC_NAMES, NPC_COUNT, name);
+              if(!self->npc) { printf("invalid npc name %s\n", name); exit(EXIT_FAILURE); }
+              self->npc_rect = parse_rect(node);
+              xmlFree(name);
+            }
+          }
+          xmlFree(type);
+        }
+        node = node->next;
+      }
+    }
+    mcur = mcur->next;
+  }
+  xmlFreeDoc(doc);
+  if(!world->tileset.image) { printf("did not find anything tileset image while parsing map\n"); exit(EXIT_FAILURE); }
+  for(int row = 0; row < MAP_ROW; row++) {
+    for(int col = 0; col < MAP_COL; col++) {
+      for(int k = 0; k < self->layers_size; k++) {
+        int tile = self->layers[k][row][col] - 1;
+        if(tile < -1 || tile >= world->tileset.tile_count) { printf("%s has tile %d, outside the tileset\n", filename, tile); exit(EXIT_FAILURE); }
+        self->solid[row][col] |= dict_get(&world->tileset.blocking_tiles, tile);
+      }
+    }
+  }
+  return self;
+}
+
+const struct map_data * world_map(struct world * self, int map) {
+  if(!self->maps[map]) self->maps[map] = parse_map(self, self->nodes[map].filename);
+  return self->maps[map];
+}
+
+void world_load_all(struct world * self) {
+  for(int i = 0; i < self->map_count; i++) world_map(self, i);
+}
@@ -0,0 +1,70 @@
+#pragma once
+// Copyright 2023 David Lareau. This program is free software under the terms of the Zero Clause BSD.
+#include <stdint.h>
+#include <stdbool.h>
+#include "data-util.h"
+#include "collision.h"
+
+// maps created with Tiled (https://www.mapeditor.org/)
+// [with many assumptions like tile size, single tileset across all maps, single warp rect, single npc]
+// the quest's screen links are hand picked, a .world file instead links every screen to the ones touching it in the world layout
+
+enum { TS = 16, MAP_COL = 16, MAP_ROW = 11, LAYERS_CAPACITY = 16 };
+
+// objects are referred to by name in the maps, and by these ids everywhere else
+enum item { NO_ITEM, ITEM_CANE, ITEM_KEY, ITEM_BOTTLE, ITEM_WATER, ITEM_HEART, ITEM_STAFF, ITEM_SPELL, ITEM_COUNT };
+enum npc { NO_NPC, NPC_ELF, NPC_BOTTLE, NPC_FLAME, NPC_WIZARD, NPC_GARDEN, NPC_DRAGON, NPC_KABOOM, NPC_COUNT };
+extern const char * ITEM_NAMES[ITEM_COUNT];
+extern const char * NPC_NAMES[NPC_COUNT];
+extern const bool NPC_SOLID[NPC_COUNT]; // otherwise just an area to talk to
+
+struct tile_animation {
+  int size;
+  int * ids;
+  uint64_t * durations;
+  uint64_t total_duration;
+};
+
+struct tileset {
+  int columns;
+  int margin, spacing; // in pixels, around the image and between tiles
+  int tile_count;
+  struct rect * sources; // tile id -> its rect in the image
+  char * image; // filename, relative to the working directory
+  struct dict animated_tiles; // tile id -> struct tile_animation
+  struct dict blocking_tiles; // tile id -> true
+};
+
+struct map_data {
+  int layers_size;
+  int (*layers)[MAP_ROW][MAP_COL]; // layers_size of them, tile id + 1, 0 is empty
+  bool solid[MAP_ROW][MAP_COL]; // any layer has a blocking tile
+  bool has_spawn;
+  double spawn_x, spawn_y;
+  int warp; // map index, -1 if none
+  struct rect warp_rect;
+  enum item item;
+  struct rect item_rect;
+  enum npc npc;
+  struct rect npc_rect;
+};
+
+struct map_node {
+  const char * filename; // relative to the working directory
+  int north, south, east, west; // map index, -1 if none
+};
+
+struct world {
+  int map_count;
+  struct map_node * nodes;
+  struct map_data ** maps; // parsed on first use
+  struct tileset tileset; // found while parsing the first map
+  bool owns_filenames; // node filenames were allocated by world_init_file()
+};
+
+void world_init(struct world * self); // the quest
+void world_init_file(struct world * self, const char * filename); // a Tiled .world file, e.g. from zeldaish-worldgen, its first map is map 0
+void world_free(struct world * self);
+const struct map_data * world_map(struct world * self, int map);
+void world_load_all(struct world * self); // parse every map now, after which the world is only ever read
+int world_find(struct world * self, const char * name); // map whose filename, without its directory, is name.tmx, or -1